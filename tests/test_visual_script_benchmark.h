@@ -0,0 +1,402 @@
+/**************************************************************************/
+/*  test_visual_script_benchmark.h                                        */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef TEST_VISUAL_SCRIPT_BENCHMARK_H
+#define TEST_VISUAL_SCRIPT_BENCHMARK_H
+
+#include "visual_script_test_graphs.h"
+
+#include "core/os/memory.h"
+#include "core/os/os.h"
+#include "scene/main/scene_tree.h"
+
+#include "tests/test_macros.h"
+
+// Interpreter benchmarks. They are skipped by default, run them on a release
+// build with:
+//   godot --test --headless --no-skip --test-case="*[Benchmark]*"
+// Heap figures are only tracked in builds with DEBUG_ENABLED.
+namespace TestVisualScriptBenchmark {
+
+using namespace VisualScriptTestGraphs;
+
+static Object *_instantiate(const Ref<VisualScript> &p_script) {
+	Object *owner = memnew(Object);
+	owner->set_script(p_script);
+	return owner;
+}
+
+static Variant _call(Object *p_owner, const StringName &p_function,
+		const Vector<Variant> &p_args) {
+	Vector<const Variant *> argptrs;
+	argptrs.resize(p_args.size());
+	for (int i = 0; i < p_args.size(); i++) {
+		argptrs.write[i] = &p_args[i];
+	}
+
+	Callable::CallError ce;
+	Variant ret = p_owner->get_script_instance()->callp(p_function,
+			argptrs.ptrw(), argptrs.size(), ce);
+	CHECK(ce.error == Callable::CallError::CALL_OK);
+	return ret;
+}
+
+// Node steps taken by one call, from the node profile.
+static uint64_t _count_steps(Object *p_owner, const StringName &p_function,
+		const Vector<Variant> &p_args) {
+	Ref<VisualScript> script = p_owner->get_script();
+	script->set_node_profiling_enabled(true);
+	script->reset_node_profile();
+	_call(p_owner, p_function, p_args);
+	Array nodes = script->get_node_profile().values();
+	script->set_node_profiling_enabled(false);
+
+	uint64_t steps = 0;
+	for (int i = 0; i < nodes.size(); i++) {
+		steps += uint64_t(Dictionary(nodes[i])["steps"]);
+	}
+	return steps;
+}
+
+// Returns the calls per second.
+static double _benchmark_calls(const String &p_label, Object *p_owner,
+		const StringName &p_function, const Vector<Variant> &p_args,
+		int p_iterations) {
+	uint64_t steps = _count_steps(p_owner, p_function, p_args);
+
+	Vector<const Variant *> argptrs;
+	argptrs.resize(p_args.size());
+	for (int i = 0; i < p_args.size(); i++) {
+		argptrs.write[i] = &p_args[i];
+	}
+	const Variant **args = argptrs.ptrw();
+	ScriptInstance *instance = p_owner->get_script_instance();
+	Callable::CallError ce;
+
+	// Warm up the caches before measuring.
+	instance->callp(p_function, args, p_args.size(), ce);
+
+	uint64_t mem_before = Memory::get_mem_usage();
+	uint64_t max_before = Memory::get_mem_max_usage();
+	uint64_t begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < p_iterations; i++) {
+		instance->callp(p_function, args, p_args.size(), ce);
+	}
+	uint64_t usec = MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1));
+	uint64_t mem_after = Memory::get_mem_usage();
+	uint64_t max_after = Memory::get_mem_max_usage();
+
+	MESSAGE(vformat("%s: %d calls/sec, %d steps/call, %.1f ns/step, heap +%d bytes (peak +%d).",
+			p_label, uint64_t(p_iterations) * 1000000 / usec, steps,
+			double(usec) * 1000.0 / double(MAX(uint64_t(p_iterations) * steps, uint64_t(1))),
+			int64_t(mem_after) - int64_t(mem_before),
+			int64_t(max_after) - int64_t(max_before)));
+
+	return double(p_iterations) * 1000000.0 / double(usec);
+}
+
+TEST_CASE("[Modules][VisualScript] Canonical graphs return the expected values") {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_while_loop(script, "while_loop");
+	build_iterator_loop(script, "iterator_loop");
+	build_operator_chain(script, "operator_chain", 10);
+	build_basic_calls(script, "basic_calls", 2);
+	build_self_calls(script, "self_calls", 2);
+	build_vector_expression(script, "vector_math");
+	build_vector_nodes(script, "vector_nodes");
+	build_generated_graph(script, "counter", 30);
+
+	Object *owner = _instantiate(script);
+	REQUIRE(owner->get_script_instance() != nullptr);
+
+	CHECK(int(_call(owner, "while_loop", { 10 })) == 10);
+	CHECK(int(_call(owner, "iterator_loop", { 10 })) == 45);
+	CHECK(int(_call(owner, "operator_chain", { 5 })) == 15);
+	CHECK(Vector3(_call(owner, "basic_calls", { Vector3() })).is_equal_approx(Vector3(0.75, 0.75, 0.75)));
+	CHECK(int(_call(owner, "self_calls", {})) == 0);
+	CHECK(int(_call(owner, "counter", { 1 })) == 10);
+	CHECK(Vector3(_call(owner, "vector_math", { Vector3(1, 0, 0), Vector3(0, 1, 0) })).is_equal_approx(Vector3(0.5, -0.5, 1)));
+	CHECK(Vector3(_call(owner, "vector_nodes", { Vector3(1, 0, 0), Vector3(0, 1, 0) })).is_equal_approx(Vector3(0.5, -0.5, 1)));
+
+	memdelete(owner);
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Loops" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_while_loop(script, "while_loop");
+	build_iterator_loop(script, "iterator_loop");
+	Object *owner = _instantiate(script);
+
+	CHECK(int(_call(owner, "while_loop", { 1000 })) == 1000);
+	CHECK(int(_call(owner, "iterator_loop", { 1000 })) == 499500);
+	_benchmark_calls("While, 1000 iterations", owner, "while_loop", { 1000 }, 1000);
+	_benchmark_calls("Iterator, 1000 iterations", owner, "iterator_loop", { 1000 }, 1000);
+
+	memdelete(owner);
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Operator chain" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_operator_chain(script, "operator_chain", 100);
+	Object *owner = _instantiate(script);
+
+	CHECK(int(_call(owner, "operator_chain", { 0 })) == 100);
+	_benchmark_calls("100 Operator nodes", owner, "operator_chain", { 0 }, 10000);
+
+	memdelete(owner);
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Function calls" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_basic_calls(script, "basic_calls", 100);
+	build_self_calls(script, "self_calls", 100);
+	Object *owner = _instantiate(script);
+
+	CHECK(Vector3(_call(owner, "basic_calls", { Vector3() })).is_equal_approx(Vector3(1, 1, 1)));
+	CHECK(int(_call(owner, "self_calls", {})) == 0);
+	double basic_nodes = 100 * _benchmark_calls("100 builtin method calls", owner, "basic_calls", { Vector3() }, 10000);
+	double self_nodes = 100 * _benchmark_calls("100 object method calls", owner, "self_calls", {}, 10000);
+
+	// The same calls the way the nodes made them before caching, looking
+	// the method up by name every time.
+	const int calls = 1000000;
+	Callable::CallError ce;
+
+	Variant vector = Vector3();
+	Variant to = Vector3(1, 1, 1);
+	Variant weight = 0.5;
+	const Variant *lerp_args[] = { &to, &weight };
+	const StringName lerp = "lerp";
+	uint64_t begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < calls; i++) {
+		Variant ret;
+		vector.callp(lerp, lerp_args, 2, ret, ce);
+		vector = ret;
+	}
+	double basic_callp = double(calls) * 1000000.0 /
+			double(MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1)));
+
+	Variant block = false;
+	const Variant *block_args[] = { &block };
+	const StringName set_block_signals = "set_block_signals";
+	begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < calls; i++) {
+		owner->callp(set_block_signals, block_args, 1, ce);
+	}
+	double self_callp = double(calls) * 1000000.0 /
+			double(MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1)));
+
+	MESSAGE(vformat("Builtin method: %d node calls/sec, %d Variant::callp() calls/sec by name (%.2fx).",
+			int64_t(basic_nodes), int64_t(basic_callp), basic_nodes / basic_callp));
+	MESSAGE(vformat("Object method: %d node calls/sec, %d Object::callp() calls/sec by name (%.2fx).",
+			int64_t(self_nodes), int64_t(self_callp), self_nodes / self_callp));
+
+	memdelete(owner);
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Expression" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_vector_expression(script, "vector_math");
+	build_vector_nodes(script, "vector_nodes");
+	Object *owner = _instantiate(script);
+
+	Vector<Variant> args = { Vector3(1, 2, 3), Vector3(4, 5, 6) };
+	CHECK(Vector3(_call(owner, "vector_math", args)).is_equal_approx(Vector3(-4.5, 4.5, -4.5)));
+	CHECK(Vector3(_call(owner, "vector_nodes", args)).is_equal_approx(Vector3(-4.5, 4.5, -4.5)));
+	double expression = _benchmark_calls("Vector3 Expression", owner, "vector_math", args, 100000);
+	double nodes = _benchmark_calls("Vector3 Operator and FunctionCall nodes", owner, "vector_nodes", args, 100000);
+	MESSAGE(vformat("Expression runs at %.2fx the speed of the equivalent nodes.",
+			expression / nodes));
+
+	memdelete(owner);
+}
+
+TEST_CASE("[SceneTree][Modules][VisualScript][Benchmark] Signal yield and resume" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_signal_yield(script, "wait_signal");
+	Object *owner = _instantiate(script);
+
+	CHECK(_call(owner, "wait_signal", {}).get_type() == Variant::OBJECT);
+	owner->notify_property_list_changed();
+
+	const int cycles = 10000;
+	const StringName function = "wait_signal";
+	ScriptInstance *instance = owner->get_script_instance();
+	Callable::CallError ce;
+	VisualScriptLanguage *language = VisualScriptLanguage::singleton;
+	uint64_t created_before = language->function_states_created.get();
+	uint64_t reused_before = language->function_states_reused.get();
+	uint64_t mem_before = Memory::get_mem_usage();
+	uint64_t begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < cycles; i++) {
+		// Drop the returned state, so it can be recycled once the frame ends.
+		instance->callp(function, nullptr, 0, ce);
+		owner->notify_property_list_changed();
+		if (i % 256 == 255) {
+			SceneTree::get_singleton()->process(1.0 / 60.0);
+		}
+	}
+	uint64_t usec = MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1));
+	uint64_t mem_after = Memory::get_mem_usage();
+
+	MESSAGE(vformat("Signal yield: %d cycles/sec, %d states created, %d reused, heap +%d bytes.",
+			uint64_t(cycles) * 1000000 / usec,
+			language->function_states_created.get() - created_before,
+			language->function_states_reused.get() - reused_before,
+			int64_t(mem_after) - int64_t(mem_before)));
+
+	memdelete(owner);
+}
+
+TEST_CASE("[SceneTree][Modules][VisualScript][Benchmark] Yield every frame" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_frame_loop(script, "frame_loop");
+
+	const int count = 10000;
+	const int frames = 100;
+	const StringName function = "frame_loop";
+	Vector<Object *> owners;
+	owners.resize(count);
+	for (int i = 0; i < count; i++) {
+		owners.write[i] = _instantiate(script);
+		CHECK(_call(owners[i], function, {}).get_type() == Variant::OBJECT);
+	}
+
+	SceneTree *tree = SceneTree::get_singleton();
+	VisualScriptLanguage *language = VisualScriptLanguage::singleton;
+	uint64_t created_before = language->function_states_created.get();
+	uint64_t reused_before = language->function_states_reused.get();
+	uint64_t mem_before = Memory::get_mem_usage();
+	uint64_t begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < frames; i++) {
+		tree->process(1.0 / 60.0);
+	}
+	uint64_t usec = MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1));
+	uint64_t mem_after = Memory::get_mem_usage();
+
+	MESSAGE(vformat("%d objects yielding every frame: %.1f usec per frame, %.1f ns per resume, %d states created, %d reused, heap +%d bytes.",
+			count, double(usec) / frames, double(usec) * 1000.0 / (double(count) * frames),
+			language->function_states_created.get() - created_before,
+			language->function_states_reused.get() - reused_before,
+			int64_t(mem_after) - int64_t(mem_before)));
+
+	// Let every loop return before freeing the owners.
+	for (int i = 0; i < count; i++) {
+		owners[i]->set("running", false);
+	}
+	tree->process(1.0 / 60.0);
+	for (int i = 0; i < count; i++) {
+		memdelete(owners[i]);
+	}
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Create instances" * doctest::skip()) {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_while_loop(script, "while_loop");
+	build_iterator_loop(script, "iterator_loop");
+	build_operator_chain(script, "operator_chain", 20);
+	build_vector_expression(script, "vector_math");
+
+	const int count = 10000;
+	Vector<Object *> owners;
+	owners.resize(count);
+
+	uint64_t mem_before = Memory::get_mem_usage();
+	uint64_t begin = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < count; i++) {
+		owners.write[i] = _instantiate(script);
+	}
+	uint64_t usec = MAX(OS::get_singleton()->get_ticks_usec() - begin, uint64_t(1));
+	uint64_t mem_after = Memory::get_mem_usage();
+
+	List<int> nodes;
+	script->get_node_list(&nodes);
+	CHECK(int(_call(owners[count - 1], "operator_chain", { 0 })) == 20);
+	MESSAGE(vformat("%d instances of %d nodes: %.2f usec and %d heap bytes each.",
+			count, nodes.size(), double(usec) / count,
+			(int64_t(mem_after) - int64_t(mem_before)) / count));
+
+	for (int i = 0; i < count; i++) {
+		memdelete(owners[i]);
+	}
+}
+
+TEST_CASE("[Modules][VisualScript][Benchmark] Compile and create generated graphs" * doctest::skip()) {
+	const int sizes[] = { 100, 1000, 10000 };
+	const int instances = 100;
+
+	for (int size : sizes) {
+		Ref<VisualScript> script;
+		script.instantiate();
+		build_generated_graph(script, "counter", size);
+		List<int> nodes;
+		script->get_node_list(&nodes);
+
+		// The first instance compiles the plan, the others share it.
+		uint64_t begin = OS::get_singleton()->get_ticks_usec();
+		Object *first = _instantiate(script);
+		uint64_t first_usec = OS::get_singleton()->get_ticks_usec() - begin;
+		CHECK(int(_call(first, "counter", { 0 })) == (size - 3) / 3);
+
+		Vector<Object *> owners;
+		owners.resize(instances);
+		begin = OS::get_singleton()->get_ticks_usec();
+		for (int i = 0; i < instances; i++) {
+			owners.write[i] = _instantiate(script);
+		}
+		uint64_t create_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+		script->invalidate_compiled_plan();
+		begin = OS::get_singleton()->get_ticks_usec();
+		script->get_compiled_plan();
+		uint64_t compile_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+		MESSAGE(vformat("%d nodes: compile %d usec, first create() %d usec, later create() %.1f usec.",
+				nodes.size(), compile_usec, first_usec,
+				double(create_usec) / instances));
+
+		memdelete(first);
+		for (int i = 0; i < instances; i++) {
+			memdelete(owners[i]);
+		}
+	}
+}
+
+} // namespace TestVisualScriptBenchmark
+
+#endif // TEST_VISUAL_SCRIPT_BENCHMARK_H
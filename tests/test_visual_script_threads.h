@@ -0,0 +1,166 @@
+/**************************************************************************/
+/*  test_visual_script_threads.h                                          */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef TEST_VISUAL_SCRIPT_THREADS_H
+#define TEST_VISUAL_SCRIPT_THREADS_H
+
+#include "visual_script_test_graphs.h"
+
+#include "core/os/thread.h"
+
+#include "tests/test_macros.h"
+
+namespace TestVisualScriptThreads {
+
+using namespace VisualScriptTestGraphs;
+
+static Ref<VisualScript> _build_script() {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_while_loop(script, "while_loop");
+	build_iterator_loop(script, "iterator_loop");
+	build_basic_calls(script, "basic_calls", 4);
+	build_vector_expression(script, "vector_math");
+	build_signal_count(script, "wait_and_count");
+	return script;
+}
+
+// Runs the functions of one instance and counts the wrong results. Only the
+// worker thread writes failures, it is read once the thread finished.
+struct Worker {
+	Object *owner = nullptr;
+	int iterations = 0;
+	int failures = 0;
+};
+
+static void _run_functions(void *p_userdata) {
+	Worker *worker = (Worker *)p_userdata;
+	ScriptInstance *instance = worker->owner->get_script_instance();
+	const StringName while_loop = "while_loop";
+	const StringName iterator_loop = "iterator_loop";
+	const StringName basic_calls = "basic_calls";
+	const StringName vector_math = "vector_math";
+
+	Variant count = 100;
+	Variant zero = Vector3();
+	Variant a = Vector3(1, 0, 0);
+	Variant b = Vector3(0, 1, 0);
+	const Variant *count_args[] = { &count };
+	const Variant *zero_args[] = { &zero };
+	const Variant *vector_args[] = { &a, &b };
+
+	for (int i = 0; i < worker->iterations; i++) {
+		Callable::CallError ce;
+		Variant ret = instance->callp(while_loop, count_args, 1, ce);
+		if (ce.error != Callable::CallError::CALL_OK || int(ret) != 100) {
+			worker->failures++;
+		}
+		ret = instance->callp(iterator_loop, count_args, 1, ce);
+		if (ce.error != Callable::CallError::CALL_OK || int(ret) != 4950) {
+			worker->failures++;
+		}
+		ret = instance->callp(basic_calls, zero_args, 1, ce);
+		if (ce.error != Callable::CallError::CALL_OK ||
+				!Vector3(ret).is_equal_approx(Vector3(0.9375, 0.9375, 0.9375))) {
+			worker->failures++;
+		}
+		ret = instance->callp(vector_math, vector_args, 2, ce);
+		if (ce.error != Callable::CallError::CALL_OK ||
+				!Vector3(ret).is_equal_approx(Vector3(0.5, -0.5, 1))) {
+			worker->failures++;
+		}
+	}
+}
+
+TEST_CASE("[Modules][VisualScript] Functions run concurrently on separate instances") {
+	Ref<VisualScript> script = _build_script();
+
+	const int thread_count = 8;
+	Worker workers[thread_count];
+	Thread threads[thread_count];
+	for (int i = 0; i < thread_count; i++) {
+		workers[i].owner = memnew(Object);
+		workers[i].owner->set_script(script);
+		workers[i].iterations = 200;
+	}
+
+	for (int i = 0; i < thread_count; i++) {
+		threads[i].start(_run_functions, &workers[i]);
+	}
+	for (int i = 0; i < thread_count; i++) {
+		threads[i].wait_to_finish();
+	}
+
+	for (int i = 0; i < thread_count; i++) {
+		CHECK_MESSAGE(workers[i].failures == 0,
+				vformat("Thread %d got %d wrong results.", i, workers[i].failures));
+		memdelete(workers[i].owner);
+	}
+}
+
+TEST_CASE("[Modules][VisualScript] Signal resumes wait for calls from another thread") {
+	Ref<VisualScript> script = _build_script();
+	Object *owner = memnew(Object);
+	owner->set_script(script);
+
+	// The worker keeps calling into the instance while this thread yields
+	// and resumes it, no resume may be lost or fail.
+	Worker worker;
+	worker.owner = owner;
+	worker.iterations = 500;
+	Thread thread;
+	thread.start(_run_functions, &worker);
+
+	const int cycles = 1000;
+	const StringName wait_and_count = "wait_and_count";
+	ScriptInstance *instance = owner->get_script_instance();
+	int yields = 0;
+	for (int i = 0; i < cycles; i++) {
+		Callable::CallError ce;
+		Variant state = instance->callp(wait_and_count, nullptr, 0, ce);
+		if (ce.error == Callable::CallError::CALL_OK &&
+				state.get_type() == Variant::OBJECT) {
+			yields++;
+		}
+		owner->notify_property_list_changed();
+	}
+
+	thread.wait_to_finish();
+
+	CHECK(yields == cycles);
+	CHECK(int(owner->get("resumed")) == cycles);
+	CHECK(worker.failures == 0);
+
+	memdelete(owner);
+}
+
+} // namespace TestVisualScriptThreads
+
+#endif // TEST_VISUAL_SCRIPT_THREADS_H
@@ -0,0 +1,72 @@
+/**************************************************************************/
+/*  test_visual_script_yield.h                                            */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef TEST_VISUAL_SCRIPT_YIELD_H
+#define TEST_VISUAL_SCRIPT_YIELD_H
+
+#include "visual_script_test_graphs.h"
+
+#include "scene/main/scene_tree.h"
+
+#include "tests/test_macros.h"
+
+namespace TestVisualScriptYield {
+
+using namespace VisualScriptTestGraphs;
+
+TEST_CASE("[SceneTree][Modules][VisualScript] Waiters on one signal can yield on it again") {
+	Ref<VisualScript> script;
+	script.instantiate();
+	build_signal_count(script, "wait_and_count", 2);
+	Object *owner = memnew(Object);
+	owner->set_script(script);
+	ScriptInstance *instance = owner->get_script_instance();
+	const StringName function = "wait_and_count";
+
+	// Both waiters resume on the first emission and wait again on the second.
+	// The states of the first round are recycled at the end of the frame, the
+	// second round reuses them.
+	for (int round = 1; round <= 2; round++) {
+		Callable::CallError ce;
+		instance->callp(function, nullptr, 0, ce);
+		instance->callp(function, nullptr, 0, ce);
+		owner->notify_property_list_changed();
+		owner->notify_property_list_changed();
+		CHECK(int(owner->get("resumed")) == round * 2);
+
+		SceneTree::get_singleton()->process(1.0 / 60.0);
+	}
+
+	memdelete(owner);
+}
+
+} // namespace TestVisualScriptYield
+
+#endif // TEST_VISUAL_SCRIPT_YIELD_H
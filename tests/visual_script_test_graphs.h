@@ -0,0 +1,413 @@
+/**************************************************************************/
+/*  visual_script_test_graphs.h                                           */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef VISUAL_SCRIPT_TEST_GRAPHS_H
+#define VISUAL_SCRIPT_TEST_GRAPHS_H
+
+#include "../visual_script.h"
+#include "../visual_script_expression.h"
+#include "../visual_script_flow_control.h"
+#include "../visual_script_func_nodes.h"
+#include "../visual_script_nodes.h"
+#include "../visual_script_yield_nodes.h"
+
+// Canonical graphs built in code, shared by the VisualScript tests and
+// benchmarks. Each builder adds one function to the script and documents
+// what it returns.
+namespace VisualScriptTestGraphs {
+
+inline int add_node(const Ref<VisualScript> &p_script,
+		const Ref<VisualScriptNode> &p_node) {
+	int id = p_script->get_available_id();
+	p_script->add_node(id, p_node);
+	return id;
+}
+
+template <class T>
+inline int add_new_node(const Ref<VisualScript> &p_script) {
+	Ref<T> node;
+	node.instantiate();
+	return add_node(p_script, node);
+}
+
+inline int add_function(const Ref<VisualScript> &p_script,
+		const StringName &p_name, const Vector<Variant::Type> &p_arguments) {
+	Ref<VisualScriptFunction> function;
+	function.instantiate();
+	for (int i = 0; i < p_arguments.size(); i++) {
+		function->add_argument(p_arguments[i], "arg" + itos(i));
+	}
+
+	int id = add_node(p_script, function);
+	p_script->add_function(p_name, id);
+	return id;
+}
+
+inline int add_return(const Ref<VisualScript> &p_script) {
+	Ref<VisualScriptReturn> node;
+	node.instantiate();
+	node->set_enable_return_value(true);
+	return add_node(p_script, node);
+}
+
+// Unconnected inputs take p_b, or p_a for the first one.
+inline int add_operator(const Ref<VisualScript> &p_script,
+		Variant::Operator p_op, Variant::Type p_type,
+		const Variant &p_a = Variant(), const Variant &p_b = Variant()) {
+	Ref<VisualScriptOperator> node;
+	node.instantiate();
+	node->set_operator(p_op);
+	node->set_typed(p_type);
+	int id = add_node(p_script, node);
+	node->set_default_input_value(0, p_a);
+	node->set_default_input_value(1, p_b);
+	return id;
+}
+
+inline int add_local_var(const Ref<VisualScript> &p_script,
+		const StringName &p_name, Variant::Type p_type) {
+	Ref<VisualScriptLocalVar> node;
+	node.instantiate();
+	node->set_var_name(p_name);
+	node->set_var_type(p_type);
+	return add_node(p_script, node);
+}
+
+inline int add_local_var_set(const Ref<VisualScript> &p_script,
+		const StringName &p_name, const Variant &p_value) {
+	Ref<VisualScriptLocalVarSet> node;
+	node.instantiate();
+	node->set_var_name(p_name);
+	node->set_var_type(p_value.get_type());
+	int id = add_node(p_script, node);
+	node->set_default_input_value(0, p_value);
+	return id;
+}
+
+// Builtin method of p_type, unconnected arguments take p_arguments.
+inline int add_basic_call(const Ref<VisualScript> &p_script,
+		Variant::Type p_type, const StringName &p_method,
+		const Vector<Variant> &p_arguments) {
+	Ref<VisualScriptFunctionCall> node;
+	node.instantiate();
+	node->set_call_mode(VisualScriptFunctionCall::CALL_MODE_BASIC_TYPE);
+	node->set_basic_type(p_type);
+	node->set_function(p_method);
+	int id = add_node(p_script, node);
+	for (int i = 0; i < p_arguments.size(); i++) {
+		node->set_default_input_value(i + 1, p_arguments[i]);
+	}
+	return id;
+}
+
+// Method of the owner, the node must be in the script to find its base type.
+inline int add_self_call(const Ref<VisualScript> &p_script,
+		const StringName &p_method, const Vector<Variant> &p_arguments) {
+	Ref<VisualScriptFunctionCall> node;
+	node.instantiate();
+	int id = add_node(p_script, node);
+	node->set_call_mode(VisualScriptFunctionCall::CALL_MODE_SELF);
+	node->set_function(p_method);
+	for (int i = 0; i < p_arguments.size(); i++) {
+		node->set_default_input_value(i, p_arguments[i]);
+	}
+	return id;
+}
+
+// Inputs are named a, b, c... in the expression.
+inline int add_expression(const Ref<VisualScript> &p_script,
+		const String &p_expression, const Vector<Variant::Type> &p_inputs,
+		Variant::Type p_output) {
+	Ref<VisualScriptExpression> node;
+	node.instantiate();
+	node->set("out_type", (int)p_output);
+	node->set("input_count", p_inputs.size());
+	for (int i = 0; i < p_inputs.size(); i++) {
+		node->set("input_" + itos(i) + "/type", (int)p_inputs[i]);
+	}
+	node->set("expression", p_expression);
+	return add_node(p_script, node);
+}
+
+// while_loop(n: int) -> int: counts a local variable up to n in a While loop.
+inline void build_while_loop(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	int function = add_function(p_script, p_name, { Variant::INT });
+	int init = add_local_var_set(p_script, "i", 0);
+	int loop = add_new_node<VisualScriptWhile>(p_script);
+	int i = add_local_var(p_script, "i", Variant::INT);
+	int less = add_operator(p_script, Variant::OP_LESS, Variant::INT);
+	int add = add_operator(p_script, Variant::OP_ADD, Variant::INT, 0, 1);
+	int increment = add_local_var_set(p_script, "i", 0);
+	int ret = add_return(p_script);
+
+	p_script->sequence_connect(function, 0, init);
+	p_script->sequence_connect(init, 0, loop);
+	p_script->sequence_connect(loop, 0, increment);
+	p_script->sequence_connect(loop, 1, ret);
+
+	p_script->data_connect(i, 0, less, 0);
+	p_script->data_connect(function, 0, less, 1);
+	p_script->data_connect(less, 0, loop, 0);
+	p_script->data_connect(i, 0, add, 0);
+	p_script->data_connect(add, 0, increment, 0);
+	p_script->data_connect(i, 0, ret, 0);
+}
+
+// iterator_loop(n: int) -> int: sums 0 to n - 1 with an Iterator.
+inline void build_iterator_loop(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	int function = add_function(p_script, p_name, { Variant::INT });
+	int init = add_local_var_set(p_script, "sum", 0);
+	int loop = add_new_node<VisualScriptIterator>(p_script);
+	int sum = add_local_var(p_script, "sum", Variant::INT);
+	int add = add_operator(p_script, Variant::OP_ADD, Variant::INT);
+	int accumulate = add_local_var_set(p_script, "sum", 0);
+	int ret = add_return(p_script);
+
+	p_script->sequence_connect(function, 0, init);
+	p_script->sequence_connect(init, 0, loop);
+	p_script->sequence_connect(loop, 0, accumulate);
+	p_script->sequence_connect(loop, 1, ret);
+
+	p_script->data_connect(function, 0, loop, 0);
+	p_script->data_connect(sum, 0, add, 0);
+	p_script->data_connect(loop, 0, add, 1);
+	p_script->data_connect(add, 0, accumulate, 0);
+	p_script->data_connect(sum, 0, ret, 0);
+}
+
+// counter(x: int) -> int: a generated graph of about p_node_count nodes, a
+// sequence of x = x + 1 steps of three nodes each. Returns x plus the number
+// of steps, (p_node_count - 3) / 3.
+inline void build_generated_graph(const Ref<VisualScript> &p_script,
+		const StringName &p_name, int p_node_count) {
+	int function = add_function(p_script, p_name, { Variant::INT });
+	int init = add_local_var_set(p_script, "x", 0);
+	p_script->sequence_connect(function, 0, init);
+	p_script->data_connect(function, 0, init, 0);
+
+	int from = init;
+	for (int i = 0; i < (p_node_count - 3) / 3; i++) {
+		int x = add_local_var(p_script, "x", Variant::INT);
+		int add = add_operator(p_script, Variant::OP_ADD, Variant::INT, 0, 1);
+		int set = add_local_var_set(p_script, "x", 0);
+		p_script->data_connect(x, 0, add, 0);
+		p_script->data_connect(add, 0, set, 0);
+		p_script->sequence_connect(from, 0, set);
+		from = set;
+	}
+
+	int ret = add_return(p_script);
+	int x = add_local_var(p_script, "x", Variant::INT);
+	p_script->sequence_connect(from, 0, ret);
+	p_script->data_connect(x, 0, ret, 0);
+}
+
+// operator_chain(x: int) -> int: adds 1 to x through p_length Operator nodes.
+inline void build_operator_chain(const Ref<VisualScript> &p_script,
+		const StringName &p_name, int p_length) {
+	int function = add_function(p_script, p_name, { Variant::INT });
+	int ret = add_return(p_script);
+	p_script->sequence_connect(function, 0, ret);
+
+	int from = function;
+	for (int i = 0; i < p_length; i++) {
+		int add = add_operator(p_script, Variant::OP_ADD, Variant::INT, 0, 1);
+		p_script->data_connect(from, 0, add, 0);
+		from = add;
+	}
+	p_script->data_connect(from, 0, ret, 0);
+}
+
+// basic_calls(v: Vector3) -> Vector3: moves v halfway to (1, 1, 1), through
+// p_length builtin lerp() calls.
+inline void build_basic_calls(const Ref<VisualScript> &p_script,
+		const StringName &p_name, int p_length) {
+	int function = add_function(p_script, p_name, { Variant::VECTOR3 });
+	int ret = add_return(p_script);
+	p_script->sequence_connect(function, 0, ret);
+
+	int from = function;
+	for (int i = 0; i < p_length; i++) {
+		int call = add_basic_call(p_script, Variant::VECTOR3, "lerp",
+				{ Vector3(1, 1, 1), 0.5 });
+		p_script->data_connect(from, 0, call, 0);
+		from = call;
+	}
+	p_script->data_connect(from, 0, ret, 0);
+}
+
+// self_calls() -> int: calls set_block_signals(false) on the owner through a
+// sequence of p_length FunctionCall nodes, then returns 0.
+inline void build_self_calls(const Ref<VisualScript> &p_script,
+		const StringName &p_name, int p_length) {
+	int function = add_function(p_script, p_name, {});
+	int ret = add_return(p_script);
+	p_script->get_node(ret)->set_default_input_value(0, 0);
+
+	int from = function;
+	for (int i = 0; i < p_length; i++) {
+		int call = add_self_call(p_script, "set_block_signals", { false });
+		p_script->sequence_connect(from, 0, call);
+		from = call;
+	}
+	p_script->sequence_connect(from, 0, ret);
+}
+
+// vector_math(a: Vector3, b: Vector3) -> Vector3: (a - b) * 0.5 + a.cross(b),
+// as one Expression node.
+inline void build_vector_expression(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	int function = add_function(p_script, p_name,
+			{ Variant::VECTOR3, Variant::VECTOR3 });
+	int expression = add_expression(p_script, "(a - b) * 0.5 + a.cross(b)",
+			{ Variant::VECTOR3, Variant::VECTOR3 }, Variant::VECTOR3);
+	int ret = add_return(p_script);
+
+	p_script->sequence_connect(function, 0, ret);
+	p_script->data_connect(function, 0, expression, 0);
+	p_script->data_connect(function, 1, expression, 1);
+	p_script->data_connect(expression, 0, ret, 0);
+}
+
+// vector_nodes(a: Vector3, b: Vector3) -> Vector3: the same math as
+// build_vector_expression(), as Operator and FunctionCall nodes.
+inline void build_vector_nodes(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	int function = add_function(p_script, p_name,
+			{ Variant::VECTOR3, Variant::VECTOR3 });
+	int subtract = add_operator(p_script, Variant::OP_SUBTRACT, Variant::VECTOR3);
+	int multiply = add_operator(p_script, Variant::OP_MULTIPLY, Variant::NIL,
+			Variant(), 0.5);
+	int cross = add_basic_call(p_script, Variant::VECTOR3, "cross", {});
+	int add = add_operator(p_script, Variant::OP_ADD, Variant::VECTOR3);
+	int ret = add_return(p_script);
+
+	p_script->sequence_connect(function, 0, ret);
+	p_script->data_connect(function, 0, subtract, 0);
+	p_script->data_connect(function, 1, subtract, 1);
+	p_script->data_connect(subtract, 0, multiply, 0);
+	p_script->data_connect(function, 0, cross, 0);
+	p_script->data_connect(function, 1, cross, 1);
+	p_script->data_connect(multiply, 0, add, 0);
+	p_script->data_connect(cross, 0, add, 1);
+	p_script->data_connect(add, 0, ret, 0);
+}
+
+// frame_loop() -> int: yields one frame at a time while the member variable
+// running is true, then returns how many frames it waited. Adds running to
+// the script.
+inline void build_frame_loop(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	p_script->add_variable("running", true);
+
+	int function = add_function(p_script, p_name, {});
+	int init = add_local_var_set(p_script, "frames", 0);
+	int loop = add_new_node<VisualScriptWhile>(p_script);
+	Ref<VisualScriptVariableGet> running;
+	running.instantiate();
+	running->set_variable("running");
+	int condition = add_node(p_script, running);
+	Ref<VisualScriptYield> yield;
+	yield.instantiate();
+	yield->set_yield_mode(VisualScriptYield::YIELD_FRAME);
+	int wait = add_node(p_script, yield);
+	int frames = add_local_var(p_script, "frames", Variant::INT);
+	int add = add_operator(p_script, Variant::OP_ADD, Variant::INT, 0, 1);
+	int count = add_local_var_set(p_script, "frames", 0);
+	int ret = add_return(p_script);
+
+	p_script->sequence_connect(function, 0, init);
+	p_script->sequence_connect(init, 0, loop);
+	p_script->sequence_connect(loop, 0, wait);
+	p_script->sequence_connect(wait, 0, count);
+	p_script->sequence_connect(loop, 1, ret);
+
+	p_script->data_connect(condition, 0, loop, 0);
+	p_script->data_connect(frames, 0, add, 0);
+	p_script->data_connect(add, 0, count, 0);
+	p_script->data_connect(frames, 0, ret, 0);
+}
+
+// wait_signal() -> int: yields until the owner emits property_list_changed,
+// then returns 1.
+inline void build_signal_yield(const Ref<VisualScript> &p_script,
+		const StringName &p_name) {
+	int function = add_function(p_script, p_name, {});
+	Ref<VisualScriptYieldSignal> yield;
+	yield.instantiate();
+	int wait = add_node(p_script, yield);
+	yield->set_call_mode(VisualScriptYieldSignal::CALL_MODE_SELF);
+	yield->set_signal("property_list_changed");
+	int ret = add_return(p_script);
+	p_script->get_node(ret)->set_default_input_value(0, 1);
+
+	p_script->sequence_connect(function, 0, wait);
+	p_script->sequence_connect(wait, 0, ret);
+}
+
+// wait_and_count(): yields until the owner emits property_list_changed, as
+// many times as p_yields, then adds 1 to the member variable resumed. Adds
+// resumed to the script.
+inline void build_signal_count(const Ref<VisualScript> &p_script,
+		const StringName &p_name, int p_yields = 1) {
+	p_script->add_variable("resumed", 0);
+
+	int function = add_function(p_script, p_name, {});
+	int from = function;
+	for (int i = 0; i < p_yields; i++) {
+		Ref<VisualScriptYieldSignal> yield;
+		yield.instantiate();
+		int wait = add_node(p_script, yield);
+		yield->set_call_mode(VisualScriptYieldSignal::CALL_MODE_SELF);
+		yield->set_signal("property_list_changed");
+		p_script->sequence_connect(from, 0, wait);
+		from = wait;
+	}
+
+	Ref<VisualScriptVariableGet> get;
+	get.instantiate();
+	get->set_variable("resumed");
+	int resumed = add_node(p_script, get);
+	int add = add_operator(p_script, Variant::OP_ADD, Variant::INT, 0, 1);
+	Ref<VisualScriptVariableSet> set;
+	set.instantiate();
+	set->set_variable("resumed");
+	int count = add_node(p_script, set);
+
+	p_script->sequence_connect(from, 0, count);
+	p_script->data_connect(resumed, 0, add, 0);
+	p_script->data_connect(add, 0, count, 0);
+}
+
+} // namespace VisualScriptTestGraphs
+
+#endif // VISUAL_SCRIPT_TEST_GRAPHS_H
@@ -34,6 +34,7 @@
 #include "core/core_string_names.h"
 #include "core/os/os.h"
 #include "scene/main/node.h"
+#include "scene/main/scene_tree.h"
 #include "visual_script_nodes.h"
 
 // Used by editor, this is not really saved.
@@ -53,11 +54,12 @@ void VisualScriptNode::set_default_input_value(int p_port,
 
 	default_input_values[p_port] = p_value;
 
-#ifdef TOOLS_ENABLED
 	if (script_used.is_valid()) {
+		script_used->invalidate_compiled_plan();
+#ifdef TOOLS_ENABLED
 		script_used->set_edited(true);
-	}
 #endif
+	}
 }
 
 Variant VisualScriptNode::get_default_input_value(int p_port) const {
@@ -67,6 +69,10 @@ Variant VisualScriptNode::get_default_input_value(int p_port) const {
 
 void VisualScriptNode::_set_default_input_values(Array p_values) {
 	default_input_values = p_values;
+
+	if (script_used.is_valid()) {
+		script_used->invalidate_compiled_plan();
+	}
 }
 
 void VisualScriptNode::validate_input_default_values() {
@@ -153,22 +159,241 @@ VisualScriptNode::VisualScriptNode() {}
 
 /////////////////////
 
-VisualScriptNodeInstance::VisualScriptNodeInstance() {}
+static int _link_indices(const Vector<int> &p_source, int *r_indices,
+		int &r_ofs) {
+	int ofs = r_ofs;
+	for (int i = 0; i < p_source.size(); i++) {
+		r_indices[r_ofs++] = p_source[i];
+	}
+	return ofs;
+}
+
+void VisualScriptCompiledPlan::_link() {
+	ERR_FAIL_COND(data);
+
+	int index_count = 0;
+	for (const NodeInfo &info : nodes) {
+		index_count += info.input_ports.size() + info.output_ports.size() +
+				info.sequence_outputs.size() + info.schedule.size();
+	}
+
+	size_t records_size = sizeof(NodeRecord) * nodes.size();
+	data = (uint8_t *)memalloc(
+			MAX(records_size + sizeof(int) * index_count, (size_t)1));
+
+	NodeRecord *records = (NodeRecord *)data;
+	int *indices = (int *)(data + records_size);
+	int ofs = 0;
+
+	// Slots written by each node itself, outputs and working memory.
+	Vector<int> own_stack_ends;
+	own_stack_ends.resize(nodes.size());
+	for (int i = 0; i < nodes.size(); i++) {
+		const NodeInfo &info = nodes[i];
+		int end = info.working_mem_idx >= 0
+				? info.working_mem_idx + info.working_mem_size
+				: 0;
+		for (int j = 0; j < info.output_ports.size(); j++) {
+			end = MAX(end, info.output_ports[j] + 1);
+		}
+		own_stack_ends.write[i] = end;
+	}
+
+	for (int i = 0; i < nodes.size(); i++) {
+		const NodeInfo &info = nodes[i];
+		NodeRecord &record = records[i];
+
+		record.stack_end = own_stack_ends[i];
+		for (int j = 0; j < info.schedule.size(); j++) {
+			record.stack_end =
+					MAX(record.stack_end, own_stack_ends[info.schedule[j]]);
+		}
+
+		record.id = info.id;
+		record.sequence_index = info.sequence_index;
+		record.working_mem_idx = info.working_mem_idx;
+		record.node = info.node;
+
+		record.input_port_ofs = _link_indices(info.input_ports, indices, ofs);
+		record.input_port_count = info.input_ports.size();
+		record.output_port_ofs = _link_indices(info.output_ports, indices, ofs);
+		record.output_port_count = info.output_ports.size();
+		record.sequence_output_ofs =
+				_link_indices(info.sequence_outputs, indices, ofs);
+		record.sequence_output_count = info.sequence_outputs.size();
+		record.schedule_ofs = _link_indices(info.schedule, indices, ofs);
+		record.schedule_size = info.schedule.size();
+	}
+
+	node_records = records;
+	index_table = indices;
+	node_count = nodes.size();
+	nodes.clear();
+}
+
+void VisualScriptCompiledPlan::_set_node_profiling(bool p_enabled) {
+	if (p_enabled && !node_counters && node_count) {
+		node_counters = memnew_arr(NodeCounter, node_count);
+	}
+
+	if (p_enabled && node_counters) {
+		node_profiling.set();
+	} else {
+		node_profiling.clear();
+	}
+}
+
+VisualScriptCompiledPlan::~VisualScriptCompiledPlan() {
+	if (data) {
+		memfree(data);
+	}
+	if (node_counters) {
+		memdelete_arr(node_counters);
+	}
+
+	if (!VisualScriptLanguage::singleton) {
+		// The language already detached the profiles.
+		for (const KeyValue<StringName, Function> &E : functions) {
+			if (E.value.profile) {
+				memdelete(E.value.profile);
+			}
+		}
+		return;
+	}
+
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
+	for (const KeyValue<StringName, Function> &E : functions) {
+		if (E.value.profile) {
+			memdelete(E.value.profile); // Leaves the profile list.
+		}
+	}
+}
+
+void VisualScriptNodeArena::reserve(size_t p_size) {
+	if (p_size == 0 || (chunks && chunks->size - chunks->used >= p_size)) {
+		return;
+	}
+
+	Chunk *chunk = (Chunk *)memalloc(_header_size() + p_size);
+	chunk->next = chunks;
+	chunk->size = p_size;
+	chunk->used = 0;
+	chunks = chunk;
+}
+
+void *VisualScriptNodeArena::alloc(size_t p_size) {
+	p_size = _align(p_size);
+
+	if (!chunks || chunks->size - chunks->used < p_size) {
+		// Only when the reserved size fell short, grow geometrically.
+		reserve(MAX(p_size, chunks ? chunks->size * 2 : (size_t)256));
+	}
+
+	void *mem = ((uint8_t *)chunks) + _header_size() + chunks->used;
+	chunks->used += p_size;
+	return mem;
+}
+
+void VisualScriptNodeArena::clear() {
+	while (chunks) {
+		Chunk *next = chunks->next;
+		memfree(chunks);
+		chunks = next;
+	}
+}
+
+thread_local VisualScriptNodeArena *VisualScriptNodeInstance::allocation_arena =
+		nullptr;
+thread_local size_t *VisualScriptNodeInstance::allocation_size = nullptr;
+
+void *VisualScriptNodeInstance::operator new(size_t p_size,
+		const char *p_description) {
+	if (allocation_arena) {
+		return allocation_arena->alloc(p_size);
+	}
+
+	if (allocation_size) {
+		*allocation_size += VisualScriptNodeArena::get_allocation_size(p_size);
+	}
+	return Memory::alloc_static(p_size, false);
+}
 
-VisualScriptNodeInstance::~VisualScriptNodeInstance() {
-	if (sequence_outputs) {
-		memdelete_arr(sequence_outputs);
+void VisualScriptNodeInstance::operator delete(void *p_mem,
+		const char *p_description) {
+	// Arena memory is released with the arena.
+	if (!allocation_arena) {
+		Memory::free_static(p_mem, false);
+	}
+}
+
+void VisualScriptNodeInstance::operator delete(void *p_mem) {
+	Memory::free_static(p_mem, false);
+}
+
+bool VisualScriptNodePathCache::is_node_at_path(Node *p_from,
+		const NodePath &p_path, Node *p_node) {
+	// Walk back from the node through the names of the path.
+	Node *base = p_node;
+	int i = p_path.get_name_count() - 1;
+	for (; i >= 0; i--) {
+		const StringName &name = p_path.get_name(i);
+		if (name == SNAME(".")) {
+			continue;
+		}
+		if (name == SNAME("..")) {
+			break;
+		}
+		if (!base || base->get_name() != name) {
+			return false; // Also the case for unique names, never cached.
+		}
+		base = base->get_parent();
+	}
+
+	if (p_path.is_absolute()) {
+		return i < 0 && !base && p_from->is_inside_tree() &&
+				p_node->is_inside_tree() &&
+				p_node->get_tree() == p_from->get_tree();
 	}
 
-	if (input_ports) {
-		memdelete_arr(input_ports);
+	// What is left must lead up from the source node to where the names start.
+	Node *up = p_from;
+	for (; i >= 0; i--) {
+		const StringName &name = p_path.get_name(i);
+		if (name == SNAME("..")) {
+			if (!up) {
+				return false;
+			}
+			up = up->get_parent();
+		} else if (name != SNAME(".")) {
+			return false; // Going down again, not checked.
+		}
 	}
 
-	if (output_ports) {
-		memdelete_arr(output_ports);
+	return base && base == up;
+}
+
+Node *VisualScriptNodePathCache::get_node(Node *p_from,
+		const NodePath &p_path) {
+	if (from == p_from->get_instance_id()) {
+		Node *cached = Object::cast_to<Node>(ObjectDB::get_instance(node));
+		if (cached && is_node_at_path(p_from, p_path, cached)) {
+			return cached;
+		}
 	}
+
+	Node *resolved = p_from->get_node(p_path);
+	from = p_from->get_instance_id();
+	// Paths the check can't follow are resolved again every time.
+	node = resolved && is_node_at_path(p_from, p_path, resolved)
+			? resolved->get_instance_id()
+			: ObjectID();
+	return resolved;
 }
 
+VisualScriptNodeInstance::VisualScriptNodeInstance() {}
+
+VisualScriptNodeInstance::~VisualScriptNodeInstance() {}
+
 void VisualScript::add_function(const StringName &p_name, int p_func_node_id) {
 	ERR_FAIL_COND(instances.size());
 	ERR_FAIL_COND(!String(p_name).is_valid_identifier());
@@ -178,6 +403,7 @@ void VisualScript::add_function(const StringName &p_name, int p_func_node_id) {
 
 	functions[p_name] = Function();
 	functions[p_name].func_id = p_func_node_id;
+	invalidate_compiled_plan();
 }
 
 bool VisualScript::has_function(const StringName &p_name) const {
@@ -190,6 +416,7 @@ void VisualScript::remove_function(const StringName &p_name) {
 
 	// Let the editor handle the node removal.
 	functions.erase(p_name);
+	invalidate_compiled_plan();
 }
 
 void VisualScript::rename_function(const StringName &p_name,
@@ -208,6 +435,7 @@ void VisualScript::rename_function(const StringName &p_name,
 
 	functions[p_new_name] = functions[p_name];
 	functions.erase(p_name);
+	invalidate_compiled_plan();
 }
 
 void VisualScript::set_scroll(const Vector2 &p_scroll) { scroll = p_scroll; }
@@ -233,44 +461,40 @@ void VisualScript::_node_ports_changed(int p_id) {
 
 	// Must revalidate all the functions.
 
-	{
-		List<SequenceConnection> to_remove;
-
-		for (const SequenceConnection &E : sequence_connections) {
-			if (E.from_node == p_id &&
-					E.from_output >= vsn->get_output_sequence_port_count()) {
-				to_remove.push_back(E);
-			}
-			if (E.to_node == p_id && !vsn->has_input_sequence_port()) {
-				to_remove.push_back(E);
+	HashMap<int, NodeConnections>::Iterator C = node_connections.find(p_id);
+	if (C) {
+		// Iterate over copies, removing a connection edits the lists.
+		Vector<SequenceConnection> sequence_outputs = C->value.sequence_outputs;
+		for (const SequenceConnection &E : sequence_outputs) {
+			if (E.from_output >= vsn->get_output_sequence_port_count()) {
+				_remove_sequence_connection(E);
 			}
 		}
 
-		while (to_remove.size()) {
-			sequence_connections.erase(to_remove.front()->get());
-			to_remove.pop_front();
+		if (!vsn->has_input_sequence_port()) {
+			Vector<SequenceConnection> sequence_inputs = C->value.sequence_inputs;
+			for (const SequenceConnection &E : sequence_inputs) {
+				_remove_sequence_connection(E);
+			}
 		}
-	}
-
-	{
-		List<DataConnection> to_remove;
 
-		for (const DataConnection &E : data_connections) {
-			if (E.from_node == p_id &&
-					E.from_port >= vsn->get_output_value_port_count()) {
-				to_remove.push_back(E);
-			}
-			if (E.to_node == p_id && E.to_port >= vsn->get_input_value_port_count()) {
-				to_remove.push_back(E);
+		Vector<DataConnection> data_outputs = C->value.data_outputs;
+		for (const DataConnection &E : data_outputs) {
+			if (E.from_port >= vsn->get_output_value_port_count()) {
+				_remove_data_connection(E);
 			}
 		}
 
-		while (to_remove.size()) {
-			data_connections.erase(to_remove.front()->get());
-			to_remove.pop_front();
+		Vector<DataConnection> data_inputs = C->value.data_inputs;
+		for (const DataConnection &E : data_inputs) {
+			if (E.to_port >= vsn->get_input_value_port_count()) {
+				_remove_data_connection(E);
+			}
 		}
 	}
 
+	invalidate_compiled_plan();
+
 #ifdef TOOLS_ENABLED
 	set_edited(true); // Something changed, let's set as edited.
 	emit_signal(SNAME("node_ports_changed"), p_id);
@@ -295,38 +519,34 @@ void VisualScript::add_node(int p_id, const Ref<VisualScriptNode> &p_node,
 	vsn->validate_input_default_values(); // Validate when fully loaded.
 
 	nodes[p_id] = nd;
+	invalidate_compiled_plan();
 }
 
 void VisualScript::remove_node(int p_id) {
 	ERR_FAIL_COND(instances.size());
 	ERR_FAIL_COND(!nodes.has(p_id));
-	{
-		List<SequenceConnection> to_remove;
 
-		for (const SequenceConnection &E : sequence_connections) {
-			if (E.from_node == p_id || E.to_node == p_id) {
-				to_remove.push_back(E);
-			}
+	HashMap<int, NodeConnections>::Iterator C = node_connections.find(p_id);
+	if (C) {
+		// Iterate over copies, removing a connection edits the lists.
+		Vector<SequenceConnection> sequence_outputs = C->value.sequence_outputs;
+		for (const SequenceConnection &E : sequence_outputs) {
+			_remove_sequence_connection(E);
 		}
 
-		while (to_remove.size()) {
-			sequence_connections.erase(to_remove.front()->get());
-			to_remove.pop_front();
+		Vector<SequenceConnection> sequence_inputs = C->value.sequence_inputs;
+		for (const SequenceConnection &E : sequence_inputs) {
+			_remove_sequence_connection(E);
 		}
-	}
-
-	{
-		List<DataConnection> to_remove;
 
-		for (const DataConnection &E : data_connections) {
-			if (E.from_node == p_id || E.to_node == p_id) {
-				to_remove.push_back(E);
-			}
+		Vector<DataConnection> data_outputs = C->value.data_outputs;
+		for (const DataConnection &E : data_outputs) {
+			_remove_data_connection(E);
 		}
 
-		while (to_remove.size()) {
-			data_connections.erase(to_remove.front()->get());
-			to_remove.pop_front();
+		Vector<DataConnection> data_inputs = C->value.data_inputs;
+		for (const DataConnection &E : data_inputs) {
+			_remove_data_connection(E);
 		}
 	}
 
@@ -335,6 +555,8 @@ void VisualScript::remove_node(int p_id) {
 	nodes[p_id].node->script_used.unref();
 
 	nodes.erase(p_id);
+	node_connections.erase(p_id);
+	invalidate_compiled_plan();
 }
 
 bool VisualScript::has_node(int p_id) const { return nodes.has(p_id); }
@@ -362,6 +584,55 @@ void VisualScript::get_node_list(List<int> *r_nodes) const {
 	}
 }
 
+void VisualScript::_add_sequence_connection(
+		const SequenceConnection &p_connection) {
+	sequence_connections.insert(p_connection);
+	node_connections[p_connection.from_node].sequence_outputs.push_back(
+			p_connection);
+	node_connections[p_connection.to_node].sequence_inputs.push_back(
+			p_connection);
+}
+
+void VisualScript::_remove_sequence_connection(
+		const SequenceConnection &p_connection) {
+	if (!sequence_connections.erase(p_connection)) {
+		return;
+	}
+
+	HashMap<int, NodeConnections>::Iterator E =
+			node_connections.find(p_connection.from_node);
+	if (E) {
+		E->value.sequence_outputs.erase(p_connection);
+	}
+	E = node_connections.find(p_connection.to_node);
+	if (E) {
+		E->value.sequence_inputs.erase(p_connection);
+	}
+}
+
+void VisualScript::_add_data_connection(const DataConnection &p_connection) {
+	data_connections.insert(p_connection);
+	node_connections[p_connection.from_node].data_outputs.push_back(
+			p_connection);
+	node_connections[p_connection.to_node].data_inputs.push_back(p_connection);
+}
+
+void VisualScript::_remove_data_connection(const DataConnection &p_connection) {
+	if (!data_connections.erase(p_connection)) {
+		return;
+	}
+
+	HashMap<int, NodeConnections>::Iterator E =
+			node_connections.find(p_connection.from_node);
+	if (E) {
+		E->value.data_outputs.erase(p_connection);
+	}
+	E = node_connections.find(p_connection.to_node);
+	if (E) {
+		E->value.data_inputs.erase(p_connection);
+	}
+}
+
 void VisualScript::sequence_connect(int p_from_node, int p_from_output,
 		int p_to_node) {
 	ERR_FAIL_COND(instances.size());
@@ -372,7 +643,8 @@ void VisualScript::sequence_connect(int p_from_node, int p_from_output,
 	sc.to_node = p_to_node;
 	ERR_FAIL_COND(sequence_connections.has(sc));
 
-	sequence_connections.insert(sc);
+	_add_sequence_connection(sc);
+	invalidate_compiled_plan();
 }
 
 void VisualScript::sequence_disconnect(int p_from_node, int p_from_output,
@@ -383,7 +655,8 @@ void VisualScript::sequence_disconnect(int p_from_node, int p_from_output,
 	sc.to_node = p_to_node;
 	ERR_FAIL_COND(!sequence_connections.has(sc));
 
-	sequence_connections.erase(sc);
+	_remove_sequence_connection(sc);
+	invalidate_compiled_plan();
 }
 
 bool VisualScript::has_sequence_connection(int p_from_node, int p_from_output,
@@ -415,7 +688,8 @@ void VisualScript::data_connect(int p_from_node, int p_from_port, int p_to_node,
 
 	ERR_FAIL_COND(data_connections.has(dc));
 
-	data_connections.insert(dc);
+	_add_data_connection(dc);
+	invalidate_compiled_plan();
 }
 
 void VisualScript::data_disconnect(int p_from_node, int p_from_port,
@@ -428,7 +702,8 @@ void VisualScript::data_disconnect(int p_from_node, int p_from_port,
 
 	ERR_FAIL_COND(!data_connections.has(dc));
 
-	data_connections.erase(dc);
+	_remove_data_connection(dc);
+	invalidate_compiled_plan();
 }
 
 bool VisualScript::has_data_connection(int p_from_node, int p_from_port,
@@ -443,8 +718,13 @@ bool VisualScript::has_data_connection(int p_from_node, int p_from_port,
 }
 
 bool VisualScript::is_input_value_port_connected(int p_node, int p_port) const {
-	for (const DataConnection &E : data_connections) {
-		if (E.to_node == p_node && E.to_port == p_port) {
+	HashMap<int, NodeConnections>::ConstIterator C = node_connections.find(p_node);
+	if (!C) {
+		return false;
+	}
+
+	for (const DataConnection &E : C->value.data_inputs) {
+		if (E.to_port == p_port) {
 			return true;
 		}
 	}
@@ -455,8 +735,13 @@ bool VisualScript::get_input_value_port_connection_source(int p_node,
 		int p_port,
 		int *r_node,
 		int *r_port) const {
-	for (const DataConnection &E : data_connections) {
-		if (E.to_node == p_node && E.to_port == p_port) {
+	HashMap<int, NodeConnections>::ConstIterator C = node_connections.find(p_node);
+	if (!C) {
+		return false;
+	}
+
+	for (const DataConnection &E : C->value.data_inputs) {
+		if (E.to_port == p_port) {
 			*r_node = E.from_node;
 			*r_port = E.from_port;
 			return true;
@@ -490,6 +775,7 @@ void VisualScript::add_variable(const StringName &p_name,
 	v._export = p_export;
 
 	variables[p_name] = v;
+	invalidate_compiled_plan();
 
 #ifdef TOOLS_ENABLED
 	_update_placeholders();
@@ -503,6 +789,7 @@ bool VisualScript::has_variable(const StringName &p_name) const {
 void VisualScript::remove_variable(const StringName &p_name) {
 	ERR_FAIL_COND(!variables.has(p_name));
 	variables.erase(p_name);
+	invalidate_compiled_plan();
 
 #ifdef TOOLS_ENABLED
 	_update_placeholders();
@@ -619,6 +906,7 @@ void VisualScript::rename_variable(const StringName &p_name,
 
 	variables[p_new_name] = variables[p_name];
 	variables.erase(p_name);
+	invalidate_compiled_plan();
 	List<int> ids;
 	get_node_list(&ids);
 	for (int &E : ids) {
@@ -773,134 +1061,806 @@ int VisualScript::get_available_id() const {
 	return (max + 1);
 }
 
-/////////////////////////////////
+Ref<VisualScriptCompiledPlan> VisualScript::get_compiled_plan() {
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
 
-bool VisualScript::can_instantiate() const {
-	return true; // ScriptServer::is_scripting_enabled();
-}
+	if (compiled_plan.is_null()) {
+		compiled_plan = _compile_plan();
+		compiled_plan->_set_node_profiling(node_profiling);
+	}
 
-bool VisualScript::is_abstract() const {
-	return false;
+	return compiled_plan;
 }
 
-StringName VisualScript::get_instance_base_type() const { return base_type; }
+void VisualScript::invalidate_compiled_plan() {
+	if (compiled_plan.is_null()) {
+		return;
+	}
 
-Ref<Script> VisualScript::get_base_script() const {
-	return Ref<Script>(); // No inheritance in visual script.
+	// Existing instances keep a reference to the plan they were created with.
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
+	compiled_plan.unref();
 }
 
-#ifdef TOOLS_ENABLED
-void VisualScript::_placeholder_erased(
-		PlaceHolderScriptInstance *p_placeholder) {
-	placeholders.erase(p_placeholder);
-}
+void VisualScript::set_node_profiling_enabled(bool p_enabled) {
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
 
-void VisualScript::_update_placeholders() {
-	if (placeholders.size() == 0) {
-		return; // No bother if no placeholders.
+	node_profiling = p_enabled;
+	if (compiled_plan.is_valid()) {
+		compiled_plan->_set_node_profiling(p_enabled);
 	}
-	List<PropertyInfo> pinfo;
-	HashMap<StringName, Variant> values;
+}
 
-	for (const KeyValue<StringName, Variable> &E : variables) {
-		if (!variables[E.key]._export) {
-			continue;
-		}
+bool VisualScript::is_node_profiling_enabled() const { return node_profiling; }
 
-		PropertyInfo p = variables[E.key].info;
-		p.name = String(E.key);
-		pinfo.push_back(p);
-		values[p.name] = variables[E.key].default_value;
+Dictionary VisualScript::get_node_profile() const {
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
+
+	Dictionary profile;
+	if (compiled_plan.is_null() || !compiled_plan->node_counters) {
+		return profile;
 	}
 
-	for (PlaceHolderScriptInstance *E : placeholders) {
-		E->update(pinfo, values);
+	// A node reached from several functions has several records.
+	HashMap<int, Pair<uint64_t, uint64_t>> totals;
+	for (int i = 0; i < compiled_plan->node_count; i++) {
+		const VisualScriptCompiledPlan::NodeCounter &counter =
+				compiled_plan->node_counters[i];
+		Pair<uint64_t, uint64_t> &total =
+				totals[compiled_plan->node_records[i].id];
+		total.first += counter.step_count.get();
+		total.second += counter.step_time.get();
+	}
+
+	for (const KeyValue<int, Pair<uint64_t, uint64_t>> &E : totals) {
+		Dictionary node;
+		node["steps"] = E.value.first;
+		node["time_usec"] = E.value.second;
+		profile[E.key] = node;
 	}
+
+	return profile;
 }
 
-#endif
+void VisualScript::reset_node_profile() {
+	MutexLock lock(VisualScriptLanguage::singleton->lock);
 
-ScriptInstance *VisualScript::instance_create(Object *p_this) {
-#ifdef TOOLS_ENABLED
+	if (compiled_plan.is_null() || !compiled_plan->node_counters) {
+		return;
+	}
 
-	if (!ScriptServer::is_scripting_enabled() && !is_tool_script) {
-		PlaceHolderScriptInstance *sins = memnew(PlaceHolderScriptInstance(
-				VisualScriptLanguage::singleton, Ref<Script>((Script *)this), p_this));
-		placeholders.insert(sins);
+	for (int i = 0; i < compiled_plan->node_count; i++) {
+		compiled_plan->node_counters[i].step_count.set(0);
+		compiled_plan->node_counters[i].step_time.set(0);
+	}
+}
 
-		List<PropertyInfo> pinfo;
-		HashMap<StringName, Variant> values;
+Ref<VisualScriptCompiledPlan> VisualScript::_compile_plan() {
+	Ref<VisualScriptCompiledPlan> plan;
+	plan.instantiate();
 
-		for (const KeyValue<StringName, Variable> &E : variables) {
-			if (!variables[E.key]._export) {
-				continue;
-			}
+	// Member variables get dense slots, so nodes can skip the name lookup.
+	for (const KeyValue<StringName, Variable> &E : variables) {
+		plan->variable_slots.insert(E.key, plan->variable_slots.size());
+	}
 
-			PropertyInfo p = variables[E.key].info;
-			p.name = String(E.key);
-			pinfo.push_back(p);
-			values[p.name] = variables[E.key].default_value;
+	// Setup functions from sequence trees.
+	for (const KeyValue<StringName, Function> &E : functions) {
+		const Function &vsfn = E.value;
+		VisualScriptCompiledPlan::Function function;
+
+		HashMap<StringName, int> local_var_indices;
+
+		if (vsfn.func_id < 0) {
+			VisualScriptLanguage::singleton->debug_break_parse(
+					get_path(), 0, "No start node in function: " + String(E.key));
+			ERR_CONTINUE(vsfn.func_id < 0);
 		}
-		sins->update(pinfo, values);
 
-		return sins;
-	}
-#endif
+		{
+			Ref<VisualScriptFunction> func_node = get_node(vsfn.func_id);
 
-	VisualScriptInstance *instance = memnew(VisualScriptInstance);
-	instance->create(Ref<VisualScript>(this), p_this);
+			if (func_node.is_null()) {
+				VisualScriptLanguage::singleton->debug_break_parse(
+						get_path(), 0,
+						"No VisualScriptFunction typed start node in function: " +
+								String(E.key));
+			}
 
-	{
-		MutexLock lock(VisualScriptLanguage::singleton->lock);
+			ERR_CONTINUE(!func_node.is_valid());
 
-		instances[p_this] = instance;
-	}
+			function.argument_count = func_node->get_argument_count();
+			function.max_stack += function.argument_count;
+			function.flow_stack_size =
+					func_node->is_stack_less() ? 0 : func_node->get_stack_size();
+			plan->max_input_args =
+					MAX(plan->max_input_args, function.argument_count);
+		}
+		// Function nodes graphs, walked through the adjacency lists so only
+		// the subgraph of this function is visited.
+		Vector<SequenceConnection> seqconns;
+		Vector<DataConnection> dataconns;
+		Vector<int> node_ids;
+		{
+			HashSet<int> visited;
+			visited.insert(vsfn.func_id);
+			node_ids.push_back(vsfn.func_id);
+
+			// Sequence flow first, breadth first from the function node.
+			for (int i = 0; i < node_ids.size(); i++) {
+				HashMap<int, NodeConnections>::ConstIterator C =
+						node_connections.find(node_ids[i]);
+				if (!C) {
+					continue;
+				}
 
-	return instance;
-}
+				for (const SequenceConnection &F : C->value.sequence_outputs) {
+					seqconns.push_back(F);
+					if (!visited.has(F.to_node)) {
+						visited.insert(F.to_node);
+						node_ids.push_back(F.to_node);
+					}
+				}
+			}
 
-bool VisualScript::instance_has(const Object *p_this) const {
-	return instances.has((Object *)p_this);
-}
+			// Then everything the sequenced nodes read their inputs from.
+			for (int i = 0; i < node_ids.size(); i++) {
+				HashMap<int, NodeConnections>::ConstIterator C =
+						node_connections.find(node_ids[i]);
+				if (!C) {
+					continue;
+				}
 
-bool VisualScript::has_source_code() const { return false; }
+				for (const DataConnection &F : C->value.data_inputs) {
+					dataconns.push_back(F);
+					if (!visited.has(F.from_node)) {
+						visited.insert(F.from_node);
+						node_ids.push_back(F.from_node);
+					}
+				}
+			}
+		}
 
-String VisualScript::get_source_code() const { return String(); }
+		// Multiple passes are required to set up this complex thing..
+		// First lay out the nodes.
+		HashMap<int, int> node_indices; // Node ID to plan index, in this function.
+		int first_index = plan->nodes.size();
+
+		for (const int &F : node_ids) {
+			ERR_CONTINUE(!nodes.has(F));
+			Ref<VisualScriptNode> node = nodes[F].node;
+
+			// Working memory size is only known by the node instance, so is the
+			// arena space instances take.
+			VisualScriptNodeInstance::allocation_size = &plan->instance_arena_size;
+			VisualScriptNodeInstance *probe = node->instantiate(nullptr);
+			VisualScriptNodeInstance::allocation_size = nullptr;
+			ERR_CONTINUE(!probe);
+			int working_mem_size = probe->get_working_memory_size();
+			function.can_yield = function.can_yield || probe->can_yield();
+			memdelete(probe);
+
+			VisualScriptCompiledPlan::NodeInfo info;
+			info.id = F;
+			info.node = node.ptr();
+			info.sequence_index = function.node_count++;
+
+			// If not assigned, will become default value.
+			info.input_ports.resize(node->get_input_value_port_count());
+			info.input_ports.fill(-1);
+			// If not assigned, will output to trash.
+			info.output_ports.resize(node->get_output_value_port_count());
+			info.output_ports.fill(-1);
+			// If it remains -1, flow ends here.
+			info.sequence_outputs.resize(node->get_output_sequence_port_count());
+			info.sequence_outputs.fill(-1);
+
+			if (Object::cast_to<VisualScriptLocalVar>(node.ptr()) ||
+					Object::cast_to<VisualScriptLocalVarSet>(*node)) {
+				// Working memory is shared only for this node, for the same
+				// variables.
+				StringName var_name;
+
+				if (Object::cast_to<VisualScriptLocalVar>(*node)) {
+					var_name = String(Object::cast_to<VisualScriptLocalVar>(*node)
+											  ->get_var_name())
+									   .strip_edges();
+				} else {
+					var_name = String(Object::cast_to<VisualScriptLocalVarSet>(*node)
+											  ->get_var_name())
+									   .strip_edges();
+				}
 
-void VisualScript::set_source_code(const String &p_code) {}
+				if (!local_var_indices.has(var_name)) {
+					local_var_indices[var_name] = function.max_stack;
+					function.max_stack++;
+				}
 
-Error VisualScript::reload(bool p_keep_state) { return OK; }
+				info.working_mem_idx = local_var_indices[var_name];
+				info.working_mem_size = 1;
 
-bool VisualScript::is_tool() const { return is_tool_script; }
+			} else if (working_mem_size) {
+				info.working_mem_idx = function.max_stack;
+				info.working_mem_size = working_mem_size;
+				function.max_stack += working_mem_size;
+			} else {
+				info.working_mem_idx = -1; // no working mem
+			}
 
-bool VisualScript::is_valid() const {
-	return true; // Always valid.
-}
+			plan->max_input_args =
+					MAX(plan->max_input_args, info.input_ports.size());
+			plan->max_output_args =
+					MAX(plan->max_output_args, info.output_ports.size());
 
-ScriptLanguage *VisualScript::get_language() const {
-	return VisualScriptLanguage::singleton;
-}
+			node_indices[F] = plan->nodes.size();
+			plan->nodes.push_back(info);
+		}
 
-bool VisualScript::has_script_signal(const StringName &p_signal) const {
-	return custom_signals.has(p_signal);
-}
+		ERR_CONTINUE(!node_indices.has(vsfn.func_id));
+		function.node = node_indices[vsfn.func_id];
+		function.trash_pos = function.max_stack++; // create pos for trash
+
+		VisualScriptCompiledPlan::NodeInfo *plan_nodes = plan->nodes.ptrw();
+
+		// Second pass, do data connections.
+		for (const DataConnection &F : dataconns) {
+			ERR_CONTINUE(!node_indices.has(F.from_node));
+			int from_index = node_indices[F.from_node];
+			VisualScriptCompiledPlan::NodeInfo &from = plan_nodes[from_index];
+			ERR_CONTINUE(!node_indices.has(F.to_node));
+			VisualScriptCompiledPlan::NodeInfo &to = plan_nodes[node_indices[F.to_node]];
+			ERR_CONTINUE((int)F.from_port >= from.output_ports.size());
+			ERR_CONTINUE((int)F.to_port >= to.input_ports.size());
+
+			if (from.output_ports[F.from_port] == -1) {
+				int stack_pos = function.max_stack++;
+				from.output_ports.write[F.from_port] = stack_pos;
+			}
 
-void VisualScript::get_script_signal_list(List<MethodInfo> *r_signals) const {
-	for (const KeyValue<StringName, Vector<Argument>> &E : custom_signals) {
-		MethodInfo mi;
-		mi.name = E.key;
-		for (int i = 0; i < E.value.size(); i++) {
-			PropertyInfo arg;
-			arg.type = E.value[i].type;
-			arg.name = E.value[i].name;
-			mi.arguments.push_back(arg);
+			if (from.sequence_outputs.is_empty() &&
+					to.dependencies.find(from_index) == -1) {
+				// If the node we are reading from has no output sequence, we must
+				// call step() before reading from it.
+				to.dependencies.push_back(from_index);
+			}
+
+			to.input_ports.write[F.to_port] =
+					from.output_ports[F.from_port]; // Read from wherever the stack
+													// is.
 		}
 
-		r_signals->push_back(mi);
-	}
-}
+		// Third pass, do sequence connections.
+		for (const SequenceConnection &F : seqconns) {
+			ERR_CONTINUE(!node_indices.has(F.from_node));
+			VisualScriptCompiledPlan::NodeInfo &from = plan_nodes[node_indices[F.from_node]];
+			ERR_CONTINUE(!node_indices.has(F.to_node));
+			ERR_CONTINUE((int)F.from_output >= from.sequence_outputs.size());
 
-bool VisualScript::get_property_default_value(const StringName &p_property,
+			from.sequence_outputs.write[F.from_output] = node_indices[F.to_node];
+		}
+
+		// fourth pass:
+		//  1) unassigned input ports to default values
+		//  2) connect unassigned output ports to trash
+		for (int i = first_index; i < plan->nodes.size(); i++) {
+			VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+
+			// Connect to default values.
+			for (int j = 0; j < info.input_ports.size(); j++) {
+				if (info.input_ports[j] == -1) {
+					// Unassigned, connect to default val.
+					info.input_ports.write[j] =
+							plan->default_values.size() |
+							VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT;
+					plan->default_values.push_back(info.node->get_default_input_value(j));
+				}
+			}
+
+			// Connect to trash.
+			for (int j = 0; j < info.output_ports.size(); j++) {
+				if (info.output_ports[j] == -1) {
+					info.output_ports.write[j] =
+							function.trash_pos; // trash is same for all
+				}
+			}
+		}
+
+		// Fifth pass, fold constant subgraphs into default values.
+		_fold_constants(plan.ptr(), first_index, function);
+
+		// Sixth pass, flatten the dependencies each sequenced node runs first.
+		_build_schedules(plan.ptr(), first_index, function);
+
+		// Seventh pass, values never alive at the same time share stack slots.
+		int unshared_stack = function.max_stack;
+		_share_stack_slots(plan.ptr(), first_index, function);
+		print_verbose(vformat("VisualScript: %s::%s() uses %d stack slots, %d before sharing.",
+				get_path(), String(E.key), function.max_stack, unshared_stack));
+
+		function.profile = memnew(VisualScriptCompiledPlan::Profile);
+		// The function node ID stands in for a line.
+		function.profile->signature =
+				get_path() + "::" + itos(vsfn.func_id) + "::" + String(E.key);
+		VisualScriptLanguage::singleton->profile_add(function.profile);
+
+		plan->functions[E.key] = function;
+	}
+
+	plan->_link();
+
+	return plan;
+}
+
+static bool _is_foldable_node(const VisualScriptNode *p_node) {
+	return Object::cast_to<VisualScriptOperator>(p_node) ||
+			Object::cast_to<VisualScriptConstant>(p_node) ||
+			Object::cast_to<VisualScriptMathConstant>(p_node) ||
+			Object::cast_to<VisualScriptBasicTypeConstant>(p_node) ||
+			Object::cast_to<VisualScriptConstructor>(p_node) ||
+			Object::cast_to<VisualScriptGlobalConstant>(p_node) ||
+			Object::cast_to<VisualScriptClassConstant>(p_node);
+}
+
+void VisualScript::_fold_constants(VisualScriptCompiledPlan *p_plan,
+		int p_first_index,
+		const VisualScriptCompiledPlan::Function &p_function) const {
+	VisualScriptCompiledPlan::NodeInfo *plan_nodes = p_plan->nodes.ptrw();
+	int node_end = p_plan->nodes.size();
+
+	Vector<bool> folded_nodes;
+	folded_nodes.resize(node_end - p_first_index);
+	folded_nodes.fill(false);
+
+	// Folding a node can make the nodes reading it foldable, repeat until
+	// nothing changes.
+	bool folded = true;
+	while (folded) {
+		folded = false;
+
+		for (int i = p_first_index; i < node_end; i++) {
+			VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+			if (folded_nodes[i - p_first_index] ||
+					!info.sequence_outputs.is_empty() ||
+					info.working_mem_idx != -1 || !_is_foldable_node(info.node)) {
+				continue;
+			}
+
+			bool constant_inputs = true;
+			for (int j = 0; j < info.input_ports.size(); j++) {
+				if (!(info.input_ports[j] &
+							VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT)) {
+					constant_inputs = false;
+					break;
+				}
+			}
+			if (!constant_inputs) {
+				continue;
+			}
+
+			// Evaluate once, nodes that fail keep running so they can report
+			// the error at the right place.
+			Vector<const Variant *> input_args;
+			input_args.resize(info.input_ports.size());
+			for (int j = 0; j < info.input_ports.size(); j++) {
+				input_args.write[j] = &p_plan->default_values[info.input_ports[j] &
+						VisualScriptNodeInstance::INPUT_MASK];
+			}
+
+			Vector<Variant> outputs;
+			outputs.resize(info.output_ports.size());
+			Vector<Variant *> output_args;
+			output_args.resize(outputs.size());
+			Variant *output_ptr = outputs.ptrw();
+			for (int j = 0; j < outputs.size(); j++) {
+				output_args.write[j] = &output_ptr[j];
+			}
+
+			VisualScriptNodeInstance *probe = info.node->instantiate(nullptr);
+			ERR_CONTINUE(!probe);
+			Callable::CallError ce;
+			String error_str;
+			probe->step(input_args.ptrw(), output_args.ptrw(),
+					VisualScriptNodeInstance::START_MODE_BEGIN_SEQUENCE, nullptr, ce,
+					error_str);
+			memdelete(probe);
+
+			if (ce.error != Callable::CallError::CALL_OK || !error_str.is_empty()) {
+				continue;
+			}
+
+			bool foldable_outputs = true;
+			for (int j = 0; j < outputs.size(); j++) {
+				if (!VisualScriptCompiledPlan::is_foldable_value(outputs[j])) {
+					foldable_outputs = false;
+					break;
+				}
+			}
+			if (!foldable_outputs) {
+				continue;
+			}
+
+			// Readers now take the results as default values.
+			for (int j = 0; j < info.output_ports.size(); j++) {
+				int slot = info.output_ports[j];
+				if (slot == p_function.trash_pos) {
+					continue;
+				}
+
+				int default_value = p_plan->default_values.size() |
+						VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT;
+				p_plan->default_values.push_back(outputs[j]);
+
+				for (int k = p_first_index; k < node_end; k++) {
+					int *input_ports = plan_nodes[k].input_ports.ptrw();
+					for (int l = 0; l < plan_nodes[k].input_ports.size(); l++) {
+						if (input_ports[l] == slot) {
+							input_ports[l] = default_value;
+						}
+					}
+				}
+			}
+
+			// And no longer need to run the node first.
+			for (int k = p_first_index; k < node_end; k++) {
+				plan_nodes[k].dependencies.erase(i);
+			}
+			folded_nodes.write[i - p_first_index] = true;
+
+			folded = true;
+		}
+	}
+}
+
+void VisualScript::_visit_dependencies(
+		const VisualScriptCompiledPlan::NodeInfo *p_nodes, int p_node,
+		int p_first_index, int p_root, int *r_visited, Vector<int> &r_schedule) {
+	if (r_visited[p_node - p_first_index] == p_root) {
+		return;
+	}
+	r_visited[p_node - p_first_index] = p_root;
+
+	const VisualScriptCompiledPlan::NodeInfo &info = p_nodes[p_node];
+	for (int i = 0; i < info.dependencies.size(); i++) {
+		_visit_dependencies(p_nodes, info.dependencies[i], p_first_index, p_root,
+				r_visited, r_schedule);
+	}
+
+	if (p_node != p_root) {
+		r_schedule.push_back(p_node);
+	}
+}
+
+void VisualScript::_build_schedules(VisualScriptCompiledPlan *p_plan,
+		int p_first_index,
+		const VisualScriptCompiledPlan::Function &p_function) const {
+	VisualScriptCompiledPlan::NodeInfo *plan_nodes = p_plan->nodes.ptrw();
+	int node_end = p_plan->nodes.size();
+
+	// Only nodes reached by the sequence flow run their dependencies.
+	Vector<bool> flow_nodes;
+	flow_nodes.resize(node_end - p_first_index);
+	flow_nodes.fill(false);
+	flow_nodes.write[p_function.node - p_first_index] = true;
+
+	for (int i = p_first_index; i < node_end; i++) {
+		const VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+		for (int j = 0; j < info.sequence_outputs.size(); j++) {
+			if (info.sequence_outputs[j] >= 0) {
+				flow_nodes.write[info.sequence_outputs[j] - p_first_index] = true;
+			}
+		}
+	}
+
+	// Depth first, so each dependency comes after the ones it reads from, and
+	// runs once even if several nodes read it.
+	Vector<int> visited;
+	visited.resize(node_end - p_first_index);
+	visited.fill(-1);
+
+	for (int i = p_first_index; i < node_end; i++) {
+		VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+		if (!flow_nodes[i - p_first_index] || info.dependencies.is_empty()) {
+			continue;
+		}
+
+		_visit_dependencies(plan_nodes, i, p_first_index, i, visited.ptrw(),
+				info.schedule);
+	}
+}
+
+void VisualScript::_share_stack_slots(VisualScriptCompiledPlan *p_plan,
+		int p_first_index,
+		VisualScriptCompiledPlan::Function &r_function) const {
+	VisualScriptCompiledPlan::NodeInfo *plan_nodes = p_plan->nodes.ptrw();
+	int node_end = p_plan->nodes.size();
+
+	// Only outputs of nodes without sequence ports are shared. These nodes run
+	// again in every schedule that reads them, so their values never outlive
+	// the schedule of the sequenced node being stepped. Arguments, working
+	// memory, outputs of sequenced nodes and the trash keep their own slots.
+	Vector<int> slot_values; // Stack slot to shareable value, or -1.
+	slot_values.resize(r_function.max_stack);
+	slot_values.fill(-1);
+	int value_count = 0;
+
+	for (int i = p_first_index; i < node_end; i++) {
+		const VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+		if (!info.sequence_outputs.is_empty() ||
+				info.node->has_input_sequence_port()) {
+			continue;
+		}
+
+		for (int j = 0; j < info.output_ports.size(); j++) {
+			if (info.output_ports[j] != r_function.trash_pos) {
+				slot_values.write[info.output_ports[j]] = value_count++;
+			}
+		}
+	}
+
+	if (value_count == 0) {
+		return;
+	}
+
+	// Replay the schedule of every sequenced node to find which values are
+	// alive at the same time.
+	Vector<StackLifetime> lifetimes;
+	lifetimes.resize(value_count);
+	StackLifetime *lifetime_ptr = lifetimes.ptrw();
+	Vector<HashSet<int>> interferences;
+	interferences.resize(value_count);
+	Vector<int> touched;
+
+	for (int i = p_first_index; i < node_end; i++) {
+		const Vector<int> &schedule = plan_nodes[i].schedule;
+		if (schedule.is_empty()) {
+			continue;
+		}
+
+		touched.clear();
+
+		// The schedule, then the sequenced node itself.
+		for (int time = 0; time <= schedule.size(); time++) {
+			const VisualScriptCompiledPlan::NodeInfo &info =
+					plan_nodes[time < schedule.size() ? schedule[time] : i];
+
+			for (int j = 0; j < info.input_ports.size(); j++) {
+				int port = info.input_ports[j];
+				if (port & VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT ||
+						slot_values[port] < 0) {
+					continue;
+				}
+
+				StackLifetime &lifetime = lifetime_ptr[slot_values[port]];
+				if (lifetime.stamp != i) {
+					// Read before written, only happens with dependency cycles.
+					// Keep the value alive for the whole schedule.
+					lifetime.stamp = i;
+					lifetime.begin = 0;
+					touched.push_back(slot_values[port]);
+				}
+				lifetime.end = time;
+			}
+
+			for (int j = 0; j < info.output_ports.size(); j++) {
+				int port = info.output_ports[j];
+				if (slot_values[port] < 0) {
+					continue;
+				}
+
+				StackLifetime &lifetime = lifetime_ptr[slot_values[port]];
+				if (lifetime.stamp != i) {
+					lifetime.stamp = i;
+					lifetime.begin = time;
+					touched.push_back(slot_values[port]);
+				}
+				lifetime.end = time;
+			}
+		}
+
+		// Lifetimes are closed intervals, so a node never gets an output in the
+		// same slot as one of its inputs.
+		for (int j = 0; j < touched.size(); j++) {
+			const StackLifetime &a = lifetimes[touched[j]];
+			for (int k = j + 1; k < touched.size(); k++) {
+				const StackLifetime &b = lifetimes[touched[k]];
+				if (a.begin <= b.end && b.begin <= a.end) {
+					interferences.write[touched[j]].insert(touched[k]);
+					interferences.write[touched[k]].insert(touched[j]);
+				}
+			}
+		}
+	}
+
+	// Give each value the lowest shared slot no interfering value uses.
+	Vector<int> value_slots;
+	value_slots.resize(value_count);
+	value_slots.fill(-1);
+	int shared_count = 0;
+
+	for (int i = 0; i < value_count; i++) {
+		HashSet<int> taken;
+		for (const int &F : interferences[i]) {
+			if (value_slots[F] >= 0) {
+				taken.insert(value_slots[F]);
+			}
+		}
+
+		int slot = 0;
+		while (taken.has(slot)) {
+			slot++;
+		}
+		value_slots.write[i] = slot;
+		shared_count = MAX(shared_count, slot + 1);
+	}
+
+	// Dedicated slots keep their order, so arguments stay at the beginning and
+	// working memory stays contiguous. Shared slots go after them.
+	Vector<int> remap;
+	remap.resize(r_function.max_stack);
+	int dedicated_count = 0;
+	for (int i = 0; i < r_function.max_stack; i++) {
+		if (slot_values[i] < 0) {
+			remap.write[i] = dedicated_count++;
+		}
+	}
+	for (int i = 0; i < r_function.max_stack; i++) {
+		if (slot_values[i] >= 0) {
+			remap.write[i] = dedicated_count + value_slots[slot_values[i]];
+		}
+	}
+
+	for (int i = p_first_index; i < node_end; i++) {
+		VisualScriptCompiledPlan::NodeInfo &info = plan_nodes[i];
+
+		if (info.working_mem_idx >= 0) {
+			info.working_mem_idx = remap[info.working_mem_idx];
+		}
+
+		int *input_ports = info.input_ports.ptrw();
+		for (int j = 0; j < info.input_ports.size(); j++) {
+			if (!(input_ports[j] & VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT)) {
+				input_ports[j] = remap[input_ports[j]];
+			}
+		}
+
+		int *output_ports = info.output_ports.ptrw();
+		for (int j = 0; j < info.output_ports.size(); j++) {
+			output_ports[j] = remap[output_ports[j]];
+		}
+	}
+
+	r_function.trash_pos = remap[r_function.trash_pos];
+	r_function.max_stack = dedicated_count + shared_count;
+}
+
+/////////////////////////////////
+
+bool VisualScript::can_instantiate() const {
+	return true; // ScriptServer::is_scripting_enabled();
+}
+
+bool VisualScript::is_abstract() const {
+	return false;
+}
+
+StringName VisualScript::get_instance_base_type() const { return base_type; }
+
+Ref<Script> VisualScript::get_base_script() const {
+	return Ref<Script>(); // No inheritance in visual script.
+}
+
+#ifdef TOOLS_ENABLED
+void VisualScript::_placeholder_erased(
+		PlaceHolderScriptInstance *p_placeholder) {
+	placeholders.erase(p_placeholder);
+}
+
+void VisualScript::_update_placeholders() {
+	if (placeholders.size() == 0) {
+		return; // No bother if no placeholders.
+	}
+	List<PropertyInfo> pinfo;
+	HashMap<StringName, Variant> values;
+
+	for (const KeyValue<StringName, Variable> &E : variables) {
+		if (!variables[E.key]._export) {
+			continue;
+		}
+
+		PropertyInfo p = variables[E.key].info;
+		p.name = String(E.key);
+		pinfo.push_back(p);
+		values[p.name] = variables[E.key].default_value;
+	}
+
+	for (PlaceHolderScriptInstance *E : placeholders) {
+		E->update(pinfo, values);
+	}
+}
+
+#endif
+
+ScriptInstance *VisualScript::instance_create(Object *p_this) {
+#ifdef TOOLS_ENABLED
+
+	if (!ScriptServer::is_scripting_enabled() && !is_tool_script) {
+		PlaceHolderScriptInstance *sins = memnew(PlaceHolderScriptInstance(
+				VisualScriptLanguage::singleton, Ref<Script>((Script *)this), p_this));
+		placeholders.insert(sins);
+
+		List<PropertyInfo> pinfo;
+		HashMap<StringName, Variant> values;
+
+		for (const KeyValue<StringName, Variable> &E : variables) {
+			if (!variables[E.key]._export) {
+				continue;
+			}
+
+			PropertyInfo p = variables[E.key].info;
+			p.name = String(E.key);
+			pinfo.push_back(p);
+			values[p.name] = variables[E.key].default_value;
+		}
+		sins->update(pinfo, values);
+
+		return sins;
+	}
+#endif
+
+	VisualScriptInstance *instance = memnew(VisualScriptInstance);
+	instance->create(Ref<VisualScript>(this), p_this);
+
+	{
+		MutexLock lock(VisualScriptLanguage::singleton->lock);
+
+		instances[p_this] = instance;
+	}
+
+	return instance;
+}
+
+bool VisualScript::instance_has(const Object *p_this) const {
+	return instances.has((Object *)p_this);
+}
+
+bool VisualScript::has_source_code() const { return false; }
+
+String VisualScript::get_source_code() const { return String(); }
+
+void VisualScript::set_source_code(const String &p_code) {}
+
+Error VisualScript::reload(bool p_keep_state) { return OK; }
+
+bool VisualScript::is_tool() const { return is_tool_script; }
+
+bool VisualScript::is_valid() const {
+	return true; // Always valid.
+}
+
+ScriptLanguage *VisualScript::get_language() const {
+	return VisualScriptLanguage::singleton;
+}
+
+bool VisualScript::has_script_signal(const StringName &p_signal) const {
+	return custom_signals.has(p_signal);
+}
+
+void VisualScript::get_script_signal_list(List<MethodInfo> *r_signals) const {
+	for (const KeyValue<StringName, Vector<Argument>> &E : custom_signals) {
+		MethodInfo mi;
+		mi.name = E.key;
+		for (int i = 0; i < E.value.size(); i++) {
+			PropertyInfo arg;
+			arg.type = E.value[i].type;
+			arg.name = E.value[i].name;
+			mi.arguments.push_back(arg);
+		}
+
+		r_signals->push_back(mi);
+	}
+}
+
+bool VisualScript::get_property_default_value(const StringName &p_property,
 		Variant &r_value) const {
 	if (!variables.has(p_property)) {
 		return false;
@@ -993,6 +1953,10 @@ bool VisualScript::are_subnodes_edited() const {
 const Variant VisualScript::get_rpc_config() const { return rpc_functions; }
 
 void VisualScript::_set_data(const Dictionary &p_data) {
+	// Functions, variables and nodes are rebuilt below, partly without going
+	// through the methods that invalidate the plan.
+	invalidate_compiled_plan();
+
 	Dictionary d = p_data;
 	if (d.has("base_type")) {
 		base_type = d["base_type"];
@@ -1239,6 +2203,15 @@ void VisualScript::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("rename_custom_signal", "name", "new_name"),
 			&VisualScript::rename_custom_signal);
 
+	ClassDB::bind_method(D_METHOD("set_node_profiling_enabled", "enabled"),
+			&VisualScript::set_node_profiling_enabled);
+	ClassDB::bind_method(D_METHOD("is_node_profiling_enabled"),
+			&VisualScript::is_node_profiling_enabled);
+	ClassDB::bind_method(D_METHOD("get_node_profile"),
+			&VisualScript::get_node_profile);
+	ClassDB::bind_method(D_METHOD("reset_node_profile"),
+			&VisualScript::reset_node_profile);
+
 	ClassDB::bind_method(D_METHOD("set_instance_base_type", "type"),
 			&VisualScript::set_instance_base_type);
 
@@ -1264,17 +2237,16 @@ bool VisualScript::inherits_script(const Ref<Script> &p_script) const {
 }
 
 RBSet<int> VisualScript::get_output_sequence_ports_connected(int from_node) {
-	List<VisualScript::SequenceConnection> *sc =
-			memnew(List<VisualScript::SequenceConnection>);
-	get_sequence_connection_list(sc);
 	RBSet<int> connected;
-	for (List<VisualScript::SequenceConnection>::Element *E = sc->front(); E;
-			E = E->next()) {
-		if (E->get().from_node == from_node) {
-			connected.insert(E->get().from_output);
+
+	HashMap<int, NodeConnections>::ConstIterator C =
+			node_connections.find(from_node);
+	if (C) {
+		for (const SequenceConnection &E : C->value.sequence_outputs) {
+			connected.insert(E.from_output);
 		}
 	}
-	memdelete(sc);
+
 	return connected;
 }
 
@@ -1289,24 +2261,13 @@ VisualScript::~VisualScript() {
 
 bool VisualScriptInstance::set(const StringName &p_name,
 		const Variant &p_value) {
-	HashMap<StringName, Variant>::Iterator E = variables.find(p_name);
-	if (!E) {
-		return false;
-	}
-
-	E->value = p_value;
-
-	return true;
+	MutexLock call_mutex_lock(call_lock);
+	return set_variable(p_name, p_value);
 }
 
 bool VisualScriptInstance::get(const StringName &p_name, Variant &r_ret) const {
-	HashMap<StringName, Variant>::ConstIterator E = variables.find(p_name);
-	if (!E) {
-		return false;
-	}
-
-	r_ret = E->value;
-	return true;
+	MutexLock call_mutex_lock(call_lock);
+	return get_variable(p_name, &r_ret);
 }
 
 void VisualScriptInstance::get_property_list(
@@ -1375,148 +2336,236 @@ bool VisualScriptInstance::has_method(const StringName &p_method) const {
 // #define VSDEBUG(m_text) print_line(m_text)
 #define VSDEBUG(m_text)
 
-void VisualScriptInstance::_dependency_step(
-		VisualScriptNodeInstance *node, int p_pass, int *pass_stack,
-		const Variant **input_args, Variant **output_args, Variant *variant_stack,
-		Callable::CallError &r_error, String &error_str,
-		VisualScriptNodeInstance **r_error_node) {
-	ERR_FAIL_COND(node->pass_idx == -1);
+// Call frames of the functions running in this thread, reused in call order.
+// The leading variants of a frame stay constructed between calls, functions
+// leave the ones they used cleared, so a call only constructs slots no
+// previous call at that depth needed.
+struct VisualScriptFramePool {
+	struct Frame {
+		uint8_t *data = nullptr;
+		int size = 0;
+		int constructed = 0; // Leading slots holding cleared variants.
+	};
+
+	LocalVector<Frame> frames;
+	uint32_t depth = 0;
+
+	void *acquire(int p_variant_count, int p_size) {
+		if (depth == frames.size()) {
+			frames.push_back(Frame());
+		}
 
-	if (pass_stack[node->pass_idx] == p_pass) {
-		return;
-	}
+		Frame &frame = frames[depth++];
+		if (frame.size < p_size) {
+			// Cleared variants need no destruction.
+			if (frame.data) {
+				memfree(frame.data);
+			}
+			frame.data = (uint8_t *)memalloc(p_size);
+			frame.size = p_size;
+			frame.constructed = 0;
+		}
 
-	pass_stack[node->pass_idx] = p_pass;
+		Variant *variants = (Variant *)frame.data;
+		for (int i = frame.constructed; i < p_variant_count; i++) {
+			memnew_placement(&variants[i], Variant);
+		}
+		frame.constructed = MAX(frame.constructed, p_variant_count);
 
-	if (!node->dependencies.is_empty()) {
-		int dc = node->dependencies.size();
-		VisualScriptNodeInstance **deps = node->dependencies.ptrw();
+		return frame.data;
+	}
 
-		for (int i = 0; i < dc; i++) {
-			_dependency_step(deps[i], p_pass, pass_stack, input_args, output_args,
-					variant_stack, r_error, error_str, r_error_node);
-			if (r_error.error != Callable::CallError::CALL_OK) {
-				return;
+	// Past the variants of the call the rest of the frame was overwritten.
+	void release(int p_variant_count) {
+		frames[--depth].constructed = p_variant_count;
+	}
+
+	~VisualScriptFramePool() {
+		for (Frame &frame : frames) {
+			if (frame.data) {
+				memfree(frame.data);
 			}
 		}
 	}
+};
 
-	for (int i = 0; i < node->input_port_count; i++) {
-		int index = node->input_ports[i] & VisualScriptNodeInstance::INPUT_MASK;
+static thread_local VisualScriptFramePool frame_pool;
 
-		if (node->input_ports[i] &
-				VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT) {
-			// Is a default value (unassigned input port).
-			input_args[i] = &default_values[index];
-		} else {
-			// Regular temporary in stack.
-			input_args[i] = &variant_stack[index];
-		}
-	}
-	for (int i = 0; i < node->output_port_count; i++) {
-		output_args[i] = &variant_stack[node->output_ports[i]];
+// Time spent in VisualScript functions called from the one running in this
+// thread, so it can be taken out of its self time.
+static thread_local uint64_t profile_child_time = 0;
+
+static void _profile_enter(VisualScriptCompiledPlan::Profile *p_profile,
+		bool p_resuming_yield, uint64_t &r_start,
+		uint64_t &r_parent_child_time) {
+	if (!p_resuming_yield) {
+		// Resuming after a yield continues the same call.
+		p_profile->call_count.increment();
+		p_profile->frame_call_count.increment();
 	}
 
-	Variant *working_mem = node->working_mem_idx >= 0
-			? &variant_stack[node->working_mem_idx]
-			: (Variant *)nullptr;
+	r_parent_child_time = profile_child_time;
+	profile_child_time = 0;
+	r_start = OS::get_singleton()->get_ticks_usec();
+}
 
-	node->step(input_args, output_args,
-			VisualScriptNodeInstance::START_MODE_BEGIN_SEQUENCE, working_mem,
-			r_error, error_str);
-	// Ignore return.
-	if (r_error.error != Callable::CallError::CALL_OK) {
-		*r_error_node = node;
-	}
+static void _profile_exit(VisualScriptCompiledPlan::Profile *p_profile,
+		uint64_t p_start, uint64_t p_parent_child_time) {
+	uint64_t total = OS::get_singleton()->get_ticks_usec() - p_start;
+	uint64_t self = total - MIN(profile_child_time, total);
+
+	p_profile->total_time.add(total);
+	p_profile->self_time.add(self);
+	p_profile->frame_total_time.add(total);
+	p_profile->frame_self_time.add(self);
+
+	profile_child_time = p_parent_child_time + total;
+}
+
+static _FORCE_INLINE_ void _count_node_step(
+		VisualScriptCompiledPlan::NodeCounter &p_counter, uint64_t p_start) {
+	p_counter.step_count.increment();
+	p_counter.step_time.add(OS::get_singleton()->get_ticks_usec() - p_start);
 }
 
 Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 		void *p_stack, int p_stack_size,
-		VisualScriptNodeInstance *p_node,
-		int p_flow_stack_pos, int p_pass,
-		bool p_resuming_yield,
+		int p_node, int p_flow_stack_pos, int p_stack_used,
+		bool p_resuming_yield, Vector<uint8_t> *p_heap_frame,
 		Callable::CallError &r_error) {
-	HashMap<StringName, Function>::Iterator F = functions.find(p_method);
+	MutexLock call_mutex_lock(call_lock);
+
+	HashMap<StringName, VisualScriptCompiledPlan::Function>::ConstIterator F =
+			plan->functions.find(p_method);
 	ERR_FAIL_COND_V(!F, Variant());
-	Function *f = &F->value;
+	const VisualScriptCompiledPlan::Function *f = &F->value;
+
+	// Captured once, so a call that started unprofiled ends unprofiled.
+	bool profiling = VisualScriptLanguage::singleton->profiling;
+	uint64_t profile_start = 0;
+	uint64_t profile_parent_child_time = 0;
+	if (profiling) {
+		_profile_enter(f->profile, p_resuming_yield, profile_start,
+				profile_parent_child_time);
+	}
+
+	VisualScriptCompiledPlan::NodeCounter *node_counters =
+			plan->node_profiling.is_set() ? plan->node_counters : nullptr;
+	uint64_t step_start = 0;
+
+	const VisualScriptCompiledPlan::NodeRecord *plan_nodes = plan->node_records;
+	const int *index_table = plan->index_table;
+	const Variant *default_values = plan->default_values.ptr();
+	VisualScriptNodeInstance *const *node_instances = instances.ptr();
 
 	// This call goes separate, so it can be yielded and suspended.
 	Variant *variant_stack = (Variant *)p_stack;
 	bool *sequence_bits = (bool *)(variant_stack + f->max_stack);
 	const Variant **input_args =
 			(const Variant **)(sequence_bits + f->node_count);
-	Variant **output_args = (Variant **)(input_args + max_input_args);
+	Variant **output_args = (Variant **)(input_args + plan->max_input_args);
 	int flow_max = f->flow_stack_size;
-	int *flow_stack =
-			flow_max ? (int *)(output_args + max_output_args) : (int *)nullptr;
-	int *pass_stack =
-			flow_stack ? (int *)(flow_stack + flow_max) : (int *)nullptr;
+	int *flow_stack = flow_max ? (int *)(output_args + plan->max_output_args)
+							   : (int *)nullptr;
 
 	String error_str;
 
-	VisualScriptNodeInstance *node = p_node;
+	int node = p_node;
 	bool error = false;
-	int current_node_id = f->node;
+	int current_node = f->node;
 	Variant return_value;
 	Variant *working_mem = nullptr;
 
 	int flow_stack_pos = p_flow_stack_pos;
+	int stack_used = p_stack_used; // Past it, variants are still cleared.
 
 #ifdef DEBUG_ENABLED
 	if (EngineDebugger::is_active()) {
 		VisualScriptLanguage::singleton->enter_function(
-				this, &p_method, variant_stack, &working_mem, &current_node_id);
+				this, &p_method, variant_stack, &working_mem, &current_node);
 	}
 #endif
 
 	while (true) {
-		p_pass++; // Increment pass.
-		current_node_id = node->get_id();
+		current_node = node;
+		const VisualScriptCompiledPlan::NodeRecord &info = plan_nodes[node];
+		stack_used = MAX(stack_used, info.stack_end);
 
-		VSDEBUG("==========AT NODE: " + itos(current_node_id) +
-				" base: " + node->get_base_node()->get_class_name());
+		VSDEBUG("==========AT NODE: " + itos(info.id) +
+				" base: " + info.node->get_class_name());
 		VSDEBUG("AT STACK POS: " + itos(flow_stack_pos));
 
 		// Setup working mem.
-		working_mem = node->working_mem_idx >= 0
-				? &variant_stack[node->working_mem_idx]
+		working_mem = info.working_mem_idx >= 0
+				? &variant_stack[info.working_mem_idx]
 				: (Variant *)nullptr;
 
-		VSDEBUG("WORKING MEM: " + itos(node->working_mem_idx));
+		VSDEBUG("WORKING MEM: " + itos(info.working_mem_idx));
 
-		if (current_node_id == f->node) {
+		if (node == f->node) {
 			// If function node, set up function arguments from beginning of stack.
 
 			for (int i = 0; i < f->argument_count; i++) {
 				input_args[i] = &variant_stack[i];
 			}
 		} else {
-			// Run dependencies first.
+			// Run dependencies first, in the order they were scheduled.
 
-			if (!node->dependencies.is_empty()) {
-				int dc = node->dependencies.size();
-				VisualScriptNodeInstance **deps = node->dependencies.ptrw();
+			int sc = info.schedule_size;
+			const int *schedule = index_table + info.schedule_ofs;
 
-				for (int i = 0; i < dc; i++) {
-					_dependency_step(deps[i], p_pass, pass_stack, input_args, output_args,
-							variant_stack, r_error, error_str, &node);
-					if (r_error.error != Callable::CallError::CALL_OK) {
-						error = true;
-						current_node_id = node->id;
-						break;
+			for (int i = 0; i < sc; i++) {
+				const VisualScriptCompiledPlan::NodeRecord &dep = plan_nodes[schedule[i]];
+
+				const int *dep_inputs = index_table + dep.input_port_ofs;
+				for (int j = 0; j < dep.input_port_count; j++) {
+					int index = dep_inputs[j] & VisualScriptNodeInstance::INPUT_MASK;
+
+					if (dep_inputs[j] & VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT) {
+						input_args[j] = &default_values[index];
+					} else {
+						input_args[j] = &variant_stack[index];
 					}
 				}
+
+				const int *dep_outputs = index_table + dep.output_port_ofs;
+				for (int j = 0; j < dep.output_port_count; j++) {
+					output_args[j] = &variant_stack[dep_outputs[j]];
+				}
+
+				Variant *dep_working_mem = dep.working_mem_idx >= 0
+						? &variant_stack[dep.working_mem_idx]
+						: (Variant *)nullptr;
+
+				if (node_counters) {
+					step_start = OS::get_singleton()->get_ticks_usec();
+				}
+
+				// Ignore return.
+				node_instances[schedule[i]]->step(input_args, output_args,
+						VisualScriptNodeInstance::START_MODE_BEGIN_SEQUENCE,
+						dep_working_mem, r_error, error_str);
+
+				if (node_counters) {
+					_count_node_step(node_counters[schedule[i]], step_start);
+				}
+				if (r_error.error != Callable::CallError::CALL_OK) {
+					error = true;
+					node = schedule[i];
+					current_node = node;
+					break;
+				}
 			}
 
 			if (!error) {
 				// Setup input pointers normally.
-				VSDEBUG("INPUT PORTS: " + itos(node->input_port_count));
+				VSDEBUG("INPUT PORTS: " + itos(info.input_port_count));
 
-				for (int i = 0; i < node->input_port_count; i++) {
-					int index =
-							node->input_ports[i] & VisualScriptNodeInstance::INPUT_MASK;
+				const int *input_ports = index_table + info.input_port_ofs;
+				for (int i = 0; i < info.input_port_count; i++) {
+					int index = input_ports[i] & VisualScriptNodeInstance::INPUT_MASK;
 
-					if (node->input_ports[i] &
+					if (input_ports[i] &
 							VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT) {
 						// Is a default value (unassigned input port).
 						input_args[i] = &default_values[index];
@@ -1536,12 +2585,15 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 
 		// Setup output pointers.
 
-		VSDEBUG("OUTPUT PORTS: " + itos(node->output_port_count));
-		for (int i = 0; i < node->output_port_count; i++) {
-			output_args[i] = &variant_stack[node->output_ports[i]];
-			VSDEBUG("PORT " + itos(i) + " AT STACK " + itos(node->output_ports[i]));
+		VSDEBUG("OUTPUT PORTS: " + itos(info.output_port_count));
+		const int *output_ports = index_table + info.output_port_ofs;
+		for (int i = 0; i < info.output_port_count; i++) {
+			output_args[i] = &variant_stack[output_ports[i]];
+			VSDEBUG("PORT " + itos(i) + " AT STACK " + itos(output_ports[i]));
 		}
 
+		VisualScriptNodeInstance *node_instance = node_instances[node];
+
 		// Do step.
 
 		VisualScriptNodeInstance::StartMode start_mode;
@@ -1561,8 +2613,16 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 
 		VSDEBUG("STEP - STARTSEQ: " + itos(start_mode));
 
-		int ret = node->step(input_args, output_args, start_mode, working_mem,
-				r_error, error_str);
+		if (node_counters) {
+			step_start = OS::get_singleton()->get_ticks_usec();
+		}
+
+		int ret = node_instance->step(input_args, output_args, start_mode,
+				working_mem, r_error, error_str);
+
+		if (node_counters) {
+			_count_node_step(node_counters[node], step_start);
+		}
 
 		if (r_error.error != Callable::CallError::CALL_OK) {
 			// Use error from step.
@@ -1572,7 +2632,7 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 
 		if (ret & VisualScriptNodeInstance::STEP_YIELD_BIT) {
 			// Yielded!
-			if (node->get_working_memory_size() == 0) {
+			if (node_instance->get_working_memory_size() == 0) {
 				r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 				error_str = RTR("A node yielded without working memory, please read "
 								"the docs on how to yield properly!");
@@ -1594,13 +2654,24 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				state->script_id = get_script()->get_instance_id();
 				state->instance = this;
 				state->function = p_method;
-				state->working_mem_index = node->working_mem_idx;
-				state->variant_stack_size = f->max_stack;
+				state->working_mem_index = info.working_mem_idx;
+				state->variant_stack_size = stack_used;
 				state->node = node;
 				state->flow_stack_pos = flow_stack_pos;
-				state->stack.resize(p_stack_size);
-				state->pass = p_pass;
-				memcpy(state->stack.ptrw(), p_stack, p_stack_size);
+				if (p_heap_frame) {
+					// The frame already lives on the heap, just hand it over.
+					if (p_heap_frame != &state->stack) {
+						state->stack = *p_heap_frame;
+						*p_heap_frame = Vector<uint8_t>();
+					}
+				} else {
+					state->stack.resize(p_stack_size);
+					memcpy(state->stack.ptrw(), p_stack, p_stack_size);
+					// The state took the values, leave the frame with cleared ones.
+					for (int i = 0; i < stack_used; i++) {
+						memnew_placement(&variant_stack[i], Variant);
+					}
+				}
 				// Step 2, run away, return directly.
 				r_error.error = Callable::CallError::CALL_OK;
 
@@ -1611,6 +2682,10 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				}
 #endif
 
+				if (profiling) {
+					_profile_exit(f->profile, profile_start, profile_parent_child_time);
+				}
+
 				return state;
 			}
 		}
@@ -1630,7 +2705,7 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				}
 			}
 
-			if (EngineDebugger::get_script_debugger()->is_breakpoint(current_node_id,
+			if (EngineDebugger::get_script_debugger()->is_breakpoint(info.id,
 						source)) {
 				do_break = true;
 			}
@@ -1647,7 +2722,7 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 		VSDEBUG("STEP RETURN: " + itos(ret));
 
 		if (ret & VisualScriptNodeInstance::STEP_EXIT_FUNCTION_BIT) {
-			if (node->get_working_memory_size() == 0) {
+			if (node_instance->get_working_memory_size() == 0) {
 				r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 				error_str = RTR("Return value must be assigned to first element of "
 								"node working memory! Fix your node please.");
@@ -1661,13 +2736,13 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 			break; // Exit function requested, bye
 		}
 
-		VisualScriptNodeInstance *next = nullptr; // Next node.
+		int next = -1; // Next node.
 
 		if ((ret == output ||
 					ret & VisualScriptNodeInstance::STEP_FLAG_PUSH_STACK_BIT) &&
-				node->sequence_output_count) {
+				info.sequence_output_count) {
 			// If no exit bit was set, and has sequence outputs, guess next node.
-			if (output >= node->sequence_output_count) {
+			if (output >= info.sequence_output_count) {
 				r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 				error_str = RTR("Node returned an invalid sequence output:") + " " +
 						itos(output);
@@ -1675,22 +2750,22 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				break;
 			}
 
-			next = node->sequence_outputs[output];
-			VSDEBUG("GOT NEXT NODE - " + (next ? itos(next->get_id()) : "Null"));
+			next = index_table[info.sequence_output_ofs + output];
+			VSDEBUG("GOT NEXT NODE - " + (next >= 0 ? itos(plan_nodes[next].id) : "Null"));
 		}
 
 		if (flow_stack) {
 			// Update flow stack pos (may have changed).
-			flow_stack[flow_stack_pos] = current_node_id;
+			flow_stack[flow_stack_pos] = node;
 
 			// Add stack push bit if requested.
 			if (ret & VisualScriptNodeInstance::STEP_FLAG_PUSH_STACK_BIT) {
 				flow_stack[flow_stack_pos] |=
 						VisualScriptNodeInstance::FLOW_STACK_PUSHED_BIT;
-				sequence_bits[node->sequence_index] = true; // Remember sequence bit.
+				sequence_bits[info.sequence_index] = true; // Remember sequence bit.
 				VSDEBUG("NEXT SEQ - FLAG BIT");
 			} else {
-				sequence_bits[node->sequence_index] = false; // Forget sequence bit.
+				sequence_bits[info.sequence_index] = false; // Forget sequence bit.
 				VSDEBUG("NEXT SEQ - NORMAL");
 			}
 
@@ -1699,15 +2774,15 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 
 				if (flow_stack_pos > 0) {
 					flow_stack_pos--;
-					node = instances[flow_stack[flow_stack_pos] &
-							VisualScriptNodeInstance::FLOW_STACK_MASK];
+					node = flow_stack[flow_stack_pos] &
+							VisualScriptNodeInstance::FLOW_STACK_MASK;
 					VSDEBUG("NEXT IS GO BACK");
 				} else {
 					VSDEBUG("NEXT IS GO BACK, BUT NO NEXT SO EXIT");
 					break; // Simply exit without value or error.
 				}
-			} else if (next) {
-				if (sequence_bits[next->sequence_index]) {
+			} else if (next >= 0) {
+				if (sequence_bits[plan_nodes[next].sequence_index]) {
 					// What happened here is that we are entering a node that is in the
 					// middle of doing a sequence (pushed stack) from the front because
 					// each node has a working memory, we can't really do a sub-sequence
@@ -1718,10 +2793,10 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 
 					for (int i = flow_stack_pos; i >= 0; i--) {
 						if ((flow_stack[i] & VisualScriptNodeInstance::FLOW_STACK_MASK) ==
-								next->get_id()) {
+								next) {
 							flow_stack_pos = i; // Roll back and remove bit.
-							flow_stack[i] = next->get_id();
-							sequence_bits[next->sequence_index] = false;
+							flow_stack[i] = next;
+							sequence_bits[plan_nodes[next].sequence_index] = false;
 							found = true;
 						}
 					}
@@ -1752,7 +2827,7 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 					node = next;
 
 					flow_stack_pos++;
-					flow_stack[flow_stack_pos] = node->get_id();
+					flow_stack[flow_stack_pos] = node;
 
 					VSDEBUG("INCREASE FLOW STACK");
 				}
@@ -1765,8 +2840,7 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				for (int i = flow_stack_pos; i >= 0; i--) {
 					VSDEBUG("FS " + itos(i) + " - " + itos(flow_stack[i]));
 					if (flow_stack[i] & VisualScriptNodeInstance::FLOW_STACK_PUSHED_BIT) {
-						node = instances[flow_stack[i] &
-								VisualScriptNodeInstance::FLOW_STACK_MASK];
+						node = flow_stack[i] & VisualScriptNodeInstance::FLOW_STACK_MASK;
 						flow_stack_pos = i;
 						found = true;
 						break;
@@ -1781,6 +2855,9 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 				VSDEBUG("NO NEXT NODE, GO BACK TO: " + itos(flow_stack_pos));
 			}
 		} else {
+			if (next < 0) {
+				break; // Stackless mode, flow ends here.
+			}
 			node = next; // Stackless mode, simply assign next node.
 		}
 	}
@@ -1790,11 +2867,10 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 		// Function, file, line, error, explanation.
 		String err_file = script->get_path();
 		String err_func = p_method;
-		int err_line = current_node_id; // Not a line but it works as one.
+		int err_line = plan_nodes[current_node].id; // Not a line but it works as one.
 
-		if (node &&
-				(r_error.error != Callable::CallError::CALL_ERROR_INVALID_METHOD ||
-						error_str.is_empty())) {
+		if (r_error.error != Callable::CallError::CALL_ERROR_INVALID_METHOD ||
+				error_str.is_empty()) {
 			if (!error_str.is_empty()) {
 				error_str += " ";
 			}
@@ -1842,9 +2918,13 @@ Variant VisualScriptInstance::_call_internal(const StringName &p_method,
 	}
 #endif
 
-	// Clean up variant stack.
-	for (int i = 0; i < f->max_stack; i++) {
-		variant_stack[i].~Variant();
+	// Clean up variant stack, the frame keeps the cleared variants.
+	for (int i = 0; i < stack_used; i++) {
+		variant_stack[i].clear();
+	}
+
+	if (profiling) {
+		_profile_exit(f->profile, profile_start, profile_parent_child_time);
 	}
 
 	return return_value;
@@ -1855,7 +2935,8 @@ Variant VisualScriptInstance::callp(const StringName &p_method,
 		Callable::CallError &r_error) {
 	r_error.error = Callable::CallError::CALL_OK; // ok by default
 
-	HashMap<StringName, Function>::Iterator F = functions.find(p_method);
+	HashMap<StringName, VisualScriptCompiledPlan::Function>::ConstIterator F =
+			plan->functions.find(p_method);
 	if (!F) {
 		r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 		return Variant();
@@ -1863,78 +2944,73 @@ Variant VisualScriptInstance::callp(const StringName &p_method,
 
 	VSDEBUG("CALLING: " + String(p_method));
 
-	Function *f = &F->value;
+	const VisualScriptCompiledPlan::Function *f = &F->value;
+	int max_input_args = plan->max_input_args;
+	int max_output_args = plan->max_output_args;
 
 	int total_stack_size = 0;
 
-	total_stack_size += f->max_stack * sizeof(Variant); // variants
-	total_stack_size += f->node_count * sizeof(bool);
-	total_stack_size +=
-			(max_input_args + max_output_args) * sizeof(Variant *); // arguments
-	total_stack_size += f->flow_stack_size * sizeof(int); // flow
-	total_stack_size += f->pass_stack_size * sizeof(int);
-
-	VSDEBUG("STACK SIZE: " + itos(total_stack_size));
-	VSDEBUG("STACK VARIANTS: : " + itos(f->max_stack));
-	VSDEBUG("SEQBITS: : " + itos(f->node_count));
-	VSDEBUG("MAX INPUT: " + itos(max_input_args));
-	VSDEBUG("MAX OUTPUT: " + itos(max_output_args));
-	VSDEBUG("FLOW STACK SIZE: " + itos(f->flow_stack_size));
-	VSDEBUG("PASS STACK SIZE: " + itos(f->pass_stack_size));
-
-	void *stack = alloca(total_stack_size);
-
-	Variant *variant_stack = (Variant *)stack;
-	bool *sequence_bits = (bool *)(variant_stack + f->max_stack);
-	const Variant **input_args =
-			(const Variant **)(sequence_bits + f->node_count);
-	Variant **output_args = (Variant **)(input_args + max_input_args);
-	int flow_max = f->flow_stack_size;
-	int *flow_stack =
-			flow_max ? (int *)(output_args + max_output_args) : (int *)nullptr;
-	int *pass_stack =
-			flow_stack ? (int *)(flow_stack + flow_max) : (int *)nullptr;
-
-	for (int i = 0; i < f->node_count; i++) {
-		sequence_bits[i] = false; // All starts as false.
-	}
-
-	memset(pass_stack, 0, f->pass_stack_size * sizeof(int));
-
-	HashMap<int, VisualScriptNodeInstance *>::Iterator E =
-			instances.find(f->node);
-	if (!E) {
-		r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
-
-		ERR_FAIL_V_MSG(Variant(), "No VisualScriptFunction node in function.");
-	}
-
-	VisualScriptNodeInstance *node = E->value;
+	total_stack_size += f->max_stack * sizeof(Variant); // variants
+	total_stack_size += f->node_count * sizeof(bool);
+	total_stack_size +=
+			(max_input_args + max_output_args) * sizeof(Variant *); // arguments
+	total_stack_size += f->flow_stack_size * sizeof(int); // flow
 
-	if (flow_stack) {
-		flow_stack[0] = node->get_id();
-	}
+	VSDEBUG("STACK SIZE: " + itos(total_stack_size));
+	VSDEBUG("STACK VARIANTS: : " + itos(f->max_stack));
+	VSDEBUG("SEQBITS: : " + itos(f->node_count));
+	VSDEBUG("MAX INPUT: " + itos(max_input_args));
+	VSDEBUG("MAX OUTPUT: " + itos(max_output_args));
+	VSDEBUG("FLOW STACK SIZE: " + itos(f->flow_stack_size));
 
 	VSDEBUG("ARGUMENTS: " + itos(f->argument_count) =
 					" RECEIVED: " + itos(p_argcount));
 
 	if (p_argcount < f->argument_count) {
 		r_error.error = Callable::CallError::CALL_ERROR_TOO_FEW_ARGUMENTS;
-		r_error.argument = node->get_input_port_count();
+		r_error.argument = f->argument_count;
 
 		return Variant();
 	}
 
 	if (p_argcount > f->argument_count) {
 		r_error.error = Callable::CallError::CALL_ERROR_TOO_MANY_ARGUMENTS;
-		r_error.argument = node->get_input_port_count();
+		r_error.argument = f->argument_count;
 
 		return Variant();
 	}
 
-	// Allocate variant stack.
-	for (int i = 0; i < f->max_stack; i++) {
-		memnew_placement(&variant_stack[i], Variant);
+	// Functions that can yield keep their frame on the heap, so a yield passes
+	// it to the function state instead of copying it. Other functions take it
+	// from the pool, with the variants already cleared.
+	Vector<uint8_t> heap_frame;
+	void *stack = nullptr;
+	if (f->can_yield) {
+		VisualScriptLanguage::singleton->acquire_yield_frame(heap_frame,
+				total_stack_size);
+		stack = heap_frame.ptrw();
+		for (int i = 0; i < f->max_stack; i++) {
+			memnew_placement(((Variant *)stack) + i, Variant);
+		}
+	} else {
+		stack = frame_pool.acquire(f->max_stack, total_stack_size);
+	}
+
+	Variant *variant_stack = (Variant *)stack;
+	bool *sequence_bits = (bool *)(variant_stack + f->max_stack);
+	const Variant **input_args =
+			(const Variant **)(sequence_bits + f->node_count);
+	Variant **output_args = (Variant **)(input_args + max_input_args);
+	int flow_max = f->flow_stack_size;
+	int *flow_stack =
+			flow_max ? (int *)(output_args + max_output_args) : (int *)nullptr;
+
+	memset(sequence_bits, 0, f->node_count * sizeof(bool)); // All starts as false.
+
+	int node = f->node;
+
+	if (flow_stack) {
+		flow_stack[0] = node;
 	}
 
 	// Allocate function arguments (must be copied for yield to work properly).
@@ -1942,8 +3018,15 @@ Variant VisualScriptInstance::callp(const StringName &p_method,
 		variant_stack[i] = *p_args[i];
 	}
 
-	return _call_internal(p_method, stack, total_stack_size, node, 0, 0, false,
-			r_error);
+	Variant ret = _call_internal(p_method, stack, total_stack_size, node, 0,
+			p_argcount, false, f->can_yield ? &heap_frame : nullptr, r_error);
+	if (!f->can_yield) {
+		frame_pool.release(f->max_stack);
+	} else if (!heap_frame.is_empty()) {
+		// Did not yield after all.
+		VisualScriptLanguage::singleton->release_yield_frame(heap_frame);
+	}
+	return ret;
 }
 
 void VisualScriptInstance::notification(int p_notification) {
@@ -1994,269 +3077,41 @@ void VisualScriptInstance::create(const Ref<VisualScript> &p_script,
 	script = p_script;
 	owner = p_owner;
 	source = p_script->get_path();
-
-	max_input_args = 0;
-	max_output_args = 0;
+	plan = p_script->get_compiled_plan();
 
 	// Setup variables.
 	{
-		for (const KeyValue<StringName, VisualScript::Variable> &E :
-				script->variables) {
-			variables[E.key] = E.value.default_value;
+		variables.resize(plan->variable_slots.size());
+		Variant *variable_ptrs = variables.ptrw();
+		for (const KeyValue<StringName, int> &E : plan->variable_slots) {
+			variable_ptrs[E.value] = script->variables[E.key].default_value;
 		}
 	}
 
-	// Setup functions from sequence trees.
-	{
-		for (const KeyValue<StringName, VisualScript::Function> &E :
-				script->functions) {
-			const VisualScript::Function &vsfn = E.value;
-			Function function;
-			function.node = vsfn.func_id;
-			function.max_stack = 0;
-			function.flow_stack_size = 0;
-			function.pass_stack_size = 0;
-			function.node_count = 0;
-
-			HashMap<StringName, int> local_var_indices;
-
-			if (function.node < 0) {
-				VisualScriptLanguage::singleton->debug_break_parse(
-						get_script()->get_path(), 0,
-						"No start node in function: " + String(E.key));
-				ERR_CONTINUE(function.node < 0);
-			}
-
-			{
-				Ref<VisualScriptFunction> func_node = script->get_node(vsfn.func_id);
-
-				if (func_node.is_null()) {
-					VisualScriptLanguage::singleton->debug_break_parse(
-							get_script()->get_path(), 0,
-							"No VisualScriptFunction typed start node in function: " +
-									String(E.key));
-				}
-
-				ERR_CONTINUE(!func_node.is_valid());
-
-				function.argument_count = func_node->get_argument_count();
-				function.max_stack += function.argument_count;
-				function.flow_stack_size =
-						func_node->is_stack_less() ? 0 : func_node->get_stack_size();
-				max_input_args = MAX(max_input_args, function.argument_count);
-			}
-			// Function nodes graphs.
-			RBSet<VisualScript::SequenceConnection> seqconns;
-			RBSet<VisualScript::DataConnection> dataconns;
-			RBSet<int> node_ids;
-			node_ids.insert(function.node);
-			{
-				List<int> nd_queue;
-				nd_queue.push_back(function.node);
-				while (!nd_queue.is_empty()) {
-					for (const VisualScript::SequenceConnection &F :
-							script->sequence_connections) {
-						if (nd_queue.front()->get() == F.from_node &&
-								!node_ids.has(F.to_node)) {
-							nd_queue.push_back(F.to_node);
-							node_ids.insert(F.to_node);
-						}
-						if (nd_queue.front()->get() == F.from_node && !seqconns.has(F)) {
-							seqconns.insert(F);
-						}
-					}
-					nd_queue.pop_front();
-				}
-				HashMap<int, HashMap<int, Pair<int, int>>>
-						dc_lut; // :: to -> to_port -> (from, from_port)
-				for (const VisualScript::DataConnection &F : script->data_connections) {
-					dc_lut[F.to_node][F.to_port] =
-							Pair<int, int>(F.from_node, F.from_port);
-				}
-				for (const int &F : node_ids) {
-					nd_queue.push_back(F);
-				}
-				List<int> dc_keys;
-				while (!nd_queue.is_empty()) {
-					int ky = nd_queue.front()->get();
-					for (const KeyValue<int, Pair<int, int>> &F : dc_lut[ky]) {
-						VisualScript::DataConnection dc;
-						dc.from_node = F.value.first;
-						dc.from_port = F.value.second;
-						dc.to_node = ky;
-						dc.to_port = F.key;
-						dataconns.insert(dc);
-						nd_queue.push_back(dc.from_node);
-						node_ids.insert(dc.from_node);
-					}
-					dc_keys
-							.clear(); // Necessary as get_key_list does a push_back not a set.
-					nd_queue.pop_front();
-				}
-			}
-
-			// Multiple passes are required to set up this complex thing..
-			// First create the nodes.
-			for (const int &F : node_ids) {
-				Ref<VisualScriptNode> node = script->nodes[F].node;
-
-				VisualScriptNodeInstance *instance =
-						node->instantiate(this); // Create instance.
-				ERR_FAIL_COND(!instance);
-
-				instance->base = node.ptr();
-
-				instance->id = F;
-				instance->input_port_count = node->get_input_value_port_count();
-				instance->input_ports = nullptr;
-				instance->output_port_count = node->get_output_value_port_count();
-				instance->output_ports = nullptr;
-				instance->sequence_output_count =
-						node->get_output_sequence_port_count();
-				instance->sequence_index = function.node_count++;
-				instance->sequence_outputs = nullptr;
-				instance->pass_idx = -1;
-
-				if (instance->input_port_count) {
-					instance->input_ports = memnew_arr(int, instance->input_port_count);
-					for (int i = 0; i < instance->input_port_count; i++) {
-						instance->input_ports[i] =
-								-1; // If not assigned, will become default value.
-					}
-				}
-
-				if (instance->output_port_count) {
-					instance->output_ports = memnew_arr(int, instance->output_port_count);
-					for (int i = 0; i < instance->output_port_count; i++) {
-						instance->output_ports[i] =
-								-1; // If not assigned, will output to trash.
-					}
-				}
-
-				if (instance->sequence_output_count) {
-					instance->sequence_outputs = memnew_arr(
-							VisualScriptNodeInstance *, instance->sequence_output_count);
-					for (int i = 0; i < instance->sequence_output_count; i++) {
-						instance->sequence_outputs[i] =
-								nullptr; // If it remains null, flow ends here.
-					}
-				}
-
-				if (Object::cast_to<VisualScriptLocalVar>(node.ptr()) ||
-						Object::cast_to<VisualScriptLocalVarSet>(*node)) {
-					// Working memory is shared only for this node, for the same
-					// variables.
-					Ref<VisualScriptLocalVar> vslv = node;
-
-					StringName var_name;
-
-					if (Object::cast_to<VisualScriptLocalVar>(*node)) {
-						var_name = String(Object::cast_to<VisualScriptLocalVar>(*node)
-												  ->get_var_name())
-										   .strip_edges();
-					} else {
-						var_name = String(Object::cast_to<VisualScriptLocalVarSet>(*node)
-												  ->get_var_name())
-										   .strip_edges();
-					}
-
-					if (!local_var_indices.has(var_name)) {
-						local_var_indices[var_name] = function.max_stack;
-						function.max_stack++;
-					}
-
-					instance->working_mem_idx = local_var_indices[var_name];
-
-				} else if (instance->get_working_memory_size()) {
-					instance->working_mem_idx = function.max_stack;
-					function.max_stack += instance->get_working_memory_size();
-				} else {
-					instance->working_mem_idx = -1; // no working mem
-				}
-
-				max_input_args = MAX(max_input_args, instance->input_port_count);
-				max_output_args = MAX(max_output_args, instance->output_port_count);
-
-				instances[F] = instance;
-			}
-
-			function.trash_pos = function.max_stack++; // create pos for trash
-
-			// Second pass, do data connections.
-			for (const VisualScript::DataConnection &F : dataconns) {
-				VisualScript::DataConnection dc = F;
-				ERR_CONTINUE(!instances.has(dc.from_node));
-				VisualScriptNodeInstance *from = instances[dc.from_node];
-				ERR_CONTINUE(!instances.has(dc.to_node));
-				VisualScriptNodeInstance *to = instances[dc.to_node];
-				ERR_CONTINUE(dc.from_port >= from->output_port_count);
-				ERR_CONTINUE(dc.to_port >= to->input_port_count);
-
-				if (from->output_ports[dc.from_port] == -1) {
-					int stack_pos = function.max_stack++;
-					from->output_ports[dc.from_port] = stack_pos;
-				}
-
-				if (from->get_sequence_output_count() == 0 &&
-						to->dependencies.find(from) == -1) {
-					// If the node we are reading from has no output sequence, we must
-					// call step() before reading from it.
-					if (from->pass_idx == -1) {
-						from->pass_idx = function.pass_stack_size;
-						function.pass_stack_size++;
-					}
-					to->dependencies.push_back(from);
-				}
-
-				to->input_ports[dc.to_port] =
-						from->output_ports[dc.from_port]; // Read from wherever the stack
-														  // is.
-			}
-
-			// Third pass, do sequence connections.
-			for (const VisualScript::SequenceConnection &F : seqconns) {
-				VisualScript::SequenceConnection sc = F;
-				ERR_CONTINUE(!instances.has(sc.from_node));
-				VisualScriptNodeInstance *from = instances[sc.from_node];
-				ERR_CONTINUE(!instances.has(sc.to_node));
-				VisualScriptNodeInstance *to = instances[sc.to_node];
-				ERR_CONTINUE(sc.from_output >= from->sequence_output_count);
+	// Node instances hold the per-instance runtime state, everything else
+	// about the graph is shared through the compiled plan.
+	instances.resize(plan->node_count);
+	VisualScriptNodeInstance **instance_ptrs = instances.ptrw();
 
-				from->sequence_outputs[sc.from_output] = to;
-			}
+	// All of them go in a single block.
+	node_arena.reserve(plan->instance_arena_size);
+	VisualScriptNodeArena *prev_arena = VisualScriptNodeInstance::allocation_arena;
+	VisualScriptNodeInstance::allocation_arena = &node_arena;
 
-			// fourth pass:
-			//  1) unassigned input ports to default values
-			//  2) connect unassigned output ports to trash
-			for (const int &F : node_ids) {
-				ERR_CONTINUE(!instances.has(F));
-
-				Ref<VisualScriptNode> node = script->nodes[F].node;
-				VisualScriptNodeInstance *instance = instances[F];
-
-				// Connect to default values.
-				for (int i = 0; i < instance->input_port_count; i++) {
-					if (instance->input_ports[i] == -1) {
-						// Unassigned, connect to default val.
-						instance->input_ports[i] =
-								default_values.size() |
-								VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT;
-						default_values.push_back(node->get_default_input_value(i));
-					}
-				}
+	for (int i = 0; i < plan->node_count; i++) {
+		const VisualScriptCompiledPlan::NodeRecord &info = plan->node_records[i];
 
-				// Connect to trash.
-				for (int i = 0; i < instance->output_port_count; i++) {
-					if (instance->output_ports[i] == -1) {
-						instance->output_ports[i] =
-								function.trash_pos; // trash is same for all
-					}
-				}
-			}
+		VisualScriptNodeInstance *instance =
+				info.node->instantiate(this); // Create instance.
+		instance_ptrs[i] = instance;
+		ERR_CONTINUE(!instance);
 
-			functions[E.key] = function;
-		}
+		instance->base = info.node;
+		instance->id = info.id;
+		instance->index = i;
 	}
+
+	VisualScriptNodeInstance::allocation_arena = prev_arena;
 }
 
 ScriptLanguage *VisualScriptInstance::get_language() {
@@ -2272,8 +3127,11 @@ VisualScriptInstance::~VisualScriptInstance() {
 		script->instances.erase(owner);
 	}
 
-	for (const KeyValue<int, VisualScriptNodeInstance *> &E : instances) {
-		memdelete(E.value);
+	// Memory goes away with the arena.
+	for (VisualScriptNodeInstance *E : instances) {
+		if (E) {
+			E->~VisualScriptNodeInstance();
+		}
 	}
 }
 
@@ -2330,11 +3188,60 @@ Variant VisualScriptFunctionState::_signal_callback(
 
 	Variant ret =
 			instance->_call_internal(function, stack.ptrw(), stack.size(), node,
-					flow_stack_pos, pass, true, r_error);
+					flow_stack_pos, variant_stack_size, true, &stack, r_error);
+	function = StringName(); // invalidate
+	return ret;
+}
+
+Variant VisualScriptFunctionState::_signal_resume(const Variant **p_args,
+		int p_argcount, Callable::CallError &r_error) {
+	ERR_FAIL_COND_V(function == StringName(), Variant());
+
+#ifdef DEBUG_ENABLED
+
+	ERR_FAIL_COND_V_MSG(
+			instance_id.is_valid() && !ObjectDB::get_instance(instance_id), Variant(),
+			"Resumed after yield, but class instance is gone.");
+	ERR_FAIL_COND_V_MSG(script_id.is_valid() &&
+					!ObjectDB::get_instance(script_id),
+			Variant(), "Resumed after yield, but script is gone.");
+
+#endif
+
+	r_error.error = Callable::CallError::CALL_OK;
+
+	// While waiting, the only reference may be the one in working memory.
+	Ref<VisualScriptFunctionState> self(this);
+
+	Variant *working_mem = ((Variant *)stack.ptrw()) + working_mem_index;
+	*working_mem = Variant();
+
+	int argcount = MIN(p_argcount, signal_argument_count);
+	for (int i = 0; i < argcount; i++) {
+		working_mem[i + 1] = *p_args[i];
+	}
+
+	Variant ret =
+			instance->_call_internal(function, stack.ptrw(), stack.size(), node,
+					flow_stack_pos, variant_stack_size, true, &stack, r_error);
 	function = StringName(); // invalidate
+
+	// Unless script code kept it, nothing references this state anymore. The
+	// signal is still being emitted, though.
+	VisualScriptLanguage::singleton->_recycle_after_emission(self);
 	return ret;
 }
 
+void VisualScriptFunctionState::connect_signal_resume(Object *p_obj,
+		const StringName &p_signal, int p_argument_count) {
+	ERR_FAIL_NULL(p_obj);
+	signal_argument_count = p_argument_count;
+
+	// No binds, the yielding frame keeps this state alive until then.
+	p_obj->connect(p_signal, Callable(this, SNAME("_signal_resume")),
+			CONNECT_ONE_SHOT);
+}
+
 void VisualScriptFunctionState::connect_to_signal(Object *p_obj,
 		const String &p_signal,
 		Array p_binds) {
@@ -2364,6 +3271,10 @@ bool VisualScriptFunctionState::is_valid() const {
 }
 
 Variant VisualScriptFunctionState::resume(Array p_args) {
+	return _resume(p_args); // Arguments go to working mem.
+}
+
+Variant VisualScriptFunctionState::_resume(const Variant &p_working_mem) {
 	ERR_FAIL_COND_V(function == StringName(), Variant());
 #ifdef DEBUG_ENABLED
 
@@ -2380,16 +3291,101 @@ Variant VisualScriptFunctionState::resume(Array p_args) {
 	r_error.error = Callable::CallError::CALL_OK;
 
 	Variant *working_mem = ((Variant *)stack.ptr()) + working_mem_index;
-
-	*working_mem = p_args; // Arguments go to working mem.
+	*working_mem = p_working_mem;
 
 	Variant ret =
 			instance->_call_internal(function, stack.ptrw(), stack.size(), node,
-					flow_stack_pos, pass, true, r_error);
+					flow_stack_pos, variant_stack_size, true, &stack, r_error);
 	function = StringName(); // invalidate
 	return ret;
 }
 
+///////////////////////////////////////////////
+
+void VisualScriptTimerWheel::_insert(const Entry &p_entry) {
+	uint64_t deadline_tick = MAX(_get_tick(p_entry.deadline), tick);
+
+	if ((deadline_tick >> LEVEL0_BITS) == (tick >> LEVEL0_BITS)) {
+		level0[deadline_tick & (LEVEL0_SIZE - 1)].push_back(p_entry);
+	} else if ((deadline_tick >> (LEVEL0_BITS + LEVEL1_BITS)) ==
+			(tick >> (LEVEL0_BITS + LEVEL1_BITS))) {
+		level1[(deadline_tick >> LEVEL0_BITS) & (LEVEL1_SIZE - 1)].push_back(p_entry);
+	} else {
+		overflow.push_back(p_entry);
+	}
+}
+
+void VisualScriptTimerWheel::_cascade(LocalVector<Entry> &p_list) {
+	uint32_t size = p_list.size();
+	for (uint32_t i = 0; i < size; i++) {
+		Entry entry = p_list[i]; // Inserting may grow the same list.
+		_insert(entry);
+	}
+
+	// Entries put back in the same list went after the original ones.
+	for (uint32_t i = size; i < p_list.size(); i++) {
+		p_list[i - size] = p_list[i];
+	}
+	p_list.resize(p_list.size() - size);
+}
+
+void VisualScriptTimerWheel::add(double p_wait,
+		const Ref<VisualScriptFunctionState> &p_state) {
+	Entry entry;
+	entry.deadline = time + MAX(p_wait, 0.0);
+	entry.state = p_state;
+	_insert(entry);
+	count++;
+}
+
+void VisualScriptTimerWheel::advance(double p_delta,
+		LocalVector<Ref<VisualScriptFunctionState>> &r_expired) {
+	time += p_delta;
+	uint64_t target = _get_tick(time);
+
+	for (uint64_t t = tick; t <= target; t++) {
+		tick = t;
+
+		if (t > cascaded_tick) {
+			cascaded_tick = t;
+			if ((t & (LEVEL0_SIZE - 1)) == 0) {
+				// A block starts, and maybe a whole round of the second level.
+				if ((t & ((1 << (LEVEL0_BITS + LEVEL1_BITS)) - 1)) == 0) {
+					_cascade(overflow);
+				}
+				_cascade(level1[(t >> LEVEL0_BITS) & (LEVEL1_SIZE - 1)]);
+			}
+		}
+
+		// Only the last tick can have entries not due yet, they stay there.
+		LocalVector<Entry> &slot = level0[t & (LEVEL0_SIZE - 1)];
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < slot.size(); i++) {
+			if (slot[i].deadline <= time) {
+				r_expired.push_back(slot[i].state);
+				count--;
+			} else {
+				if (kept != i) {
+					slot[kept] = slot[i];
+				}
+				kept++;
+			}
+		}
+		slot.resize(kept);
+	}
+}
+
+void VisualScriptTimerWheel::clear() {
+	for (int i = 0; i < LEVEL0_SIZE; i++) {
+		level0[i].clear();
+	}
+	for (int i = 0; i < LEVEL1_SIZE; i++) {
+		level1[i].clear();
+	}
+	overflow.clear();
+	count = 0;
+}
+
 void VisualScriptFunctionState::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("connect_to_signal", "obj", "signals", "args"),
 			&VisualScriptFunctionState::connect_to_signal);
@@ -2400,6 +3396,9 @@ void VisualScriptFunctionState::_bind_methods() {
 	ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "_signal_callback",
 			&VisualScriptFunctionState::_signal_callback,
 			MethodInfo("_signal_callback"));
+	ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "_signal_resume",
+			&VisualScriptFunctionState::_signal_resume,
+			MethodInfo("_signal_resume"));
 }
 
 VisualScriptFunctionState::VisualScriptFunctionState() {}
@@ -2420,11 +3419,189 @@ String VisualScriptLanguage::get_name() const { return "VisualScript"; }
 /* LANGUAGE FUNCTIONS */
 void VisualScriptLanguage::init() {}
 
+void VisualScriptLanguage::queue_frame_resume(SceneTree *p_tree,
+		bool p_physics, const Ref<VisualScriptFunctionState> &p_state) {
+	MutexLock mutex_lock(lock);
+
+	// A single connection per frame type resumes all the queued states.
+	if (p_tree->get_instance_id() != frame_resume_tree) {
+		p_tree->connect("process_frame",
+				callable_mp(this, &VisualScriptLanguage::_process_frame));
+		p_tree->connect("physics_frame",
+				callable_mp(this, &VisualScriptLanguage::_physics_frame));
+		frame_resume_tree = p_tree->get_instance_id();
+	}
+
+	int type = p_physics ? FRAME_RESUME_PHYSICS : FRAME_RESUME_PROCESS;
+	frame_resume_queues[type][frame_resume_current[type]].push_back(p_state);
+}
+
+void VisualScriptLanguage::_resume_frame_queue(int p_type) {
+	LocalVector<Ref<VisualScriptFunctionState>> *queue = nullptr;
+	{
+		// States yielding again while resumed wait for the next frame.
+		MutexLock mutex_lock(lock);
+		queue = &frame_resume_queues[p_type][frame_resume_current[p_type]];
+		frame_resume_current[p_type] ^= 1;
+	}
+
+	for (uint32_t i = 0; i < queue->size(); i++) {
+		// Might have been resumed by hand meanwhile.
+		if ((*queue)[i]->is_valid()) {
+			(*queue)[i]->_resume(Variant()); // No Array to allocate per resume.
+			_recycle_function_state((*queue)[i]);
+		}
+	}
+
+	queue->clear(); // Keeps the memory for the next frame.
+}
+
+void VisualScriptLanguage::queue_timer_resume(double p_wait,
+		const Ref<VisualScriptFunctionState> &p_state) {
+	MutexLock mutex_lock(lock);
+
+	if (!resume_timers_registered) {
+		SceneTree::add_idle_callback(&VisualScriptLanguage::_advance_resume_timers);
+		resume_timers_registered = true;
+	}
+
+	resume_timers.add(p_wait, p_state);
+}
+
+Ref<VisualScriptFunctionState> VisualScriptLanguage::create_function_state() {
+	{
+		MutexLock mutex_lock(lock);
+		if (function_state_pool.size()) {
+			Ref<VisualScriptFunctionState> state =
+					function_state_pool[function_state_pool.size() - 1];
+			function_state_pool.remove_at(function_state_pool.size() - 1);
+			function_states_reused.increment();
+			return state;
+		}
+	}
+
+	Ref<VisualScriptFunctionState> state;
+	state.instantiate();
+	function_states_created.increment();
+	return state;
+}
+
+void VisualScriptLanguage::_recycle_function_state(
+		const Ref<VisualScriptFunctionState> &p_state) {
+	// Script code may still hold it, then it is not ours to reuse.
+	if (p_state->get_reference_count() > 1 || p_state->is_valid()) {
+		return;
+	}
+
+	p_state->instance = nullptr;
+	p_state->instance_id = ObjectID();
+	p_state->script_id = ObjectID();
+
+	MutexLock mutex_lock(lock);
+	if (!p_state->stack.is_empty()) {
+		release_yield_frame(p_state->stack);
+	}
+	if (function_state_pool.size() < FUNCTION_STATE_POOL_MAX) {
+		function_state_pool.push_back(p_state);
+	}
+}
+
+void VisualScriptLanguage::_recycle_after_emission(
+		const Ref<VisualScriptFunctionState> &p_state) {
+	MutexLock mutex_lock(lock);
+
+	if (!signal_resumed_registered) {
+		SceneTree::add_idle_callback(&VisualScriptLanguage::_recycle_signal_resumed_states);
+		signal_resumed_registered = true;
+	}
+
+	// Without a tree to end frames, states beyond the pool size are just freed.
+	LocalVector<Ref<VisualScriptFunctionState>> &states =
+			signal_resumed_states[signal_resumed_current];
+	if (states.size() < FUNCTION_STATE_POOL_MAX) {
+		states.push_back(p_state);
+	}
+}
+
+void VisualScriptLanguage::_recycle_signal_resumed_states() {
+	VisualScriptLanguage *language = singleton;
+	if (!language) {
+		return;
+	}
+
+	LocalVector<Ref<VisualScriptFunctionState>> *states = nullptr;
+	{
+		MutexLock mutex_lock(language->lock);
+		states = &language->signal_resumed_states[language->signal_resumed_current];
+		language->signal_resumed_current ^= 1;
+	}
+
+	for (uint32_t i = 0; i < states->size(); i++) {
+		language->_recycle_function_state((*states)[i]);
+	}
+
+	states->clear(); // Keeps the memory for the next frame.
+}
+
+void VisualScriptLanguage::acquire_yield_frame(Vector<uint8_t> &r_frame,
+		int p_size) {
+	{
+		MutexLock mutex_lock(lock);
+		if (yield_frame_pool.size()) {
+			r_frame = yield_frame_pool[yield_frame_pool.size() - 1];
+			yield_frame_pool.remove_at(yield_frame_pool.size() - 1);
+		}
+	}
+
+	r_frame.resize(p_size);
+}
+
+// Frames come back with their variants cleared.
+void VisualScriptLanguage::release_yield_frame(Vector<uint8_t> &p_frame) {
+	MutexLock mutex_lock(lock);
+	if (yield_frame_pool.size() < FUNCTION_STATE_POOL_MAX) {
+		yield_frame_pool.push_back(p_frame);
+	}
+	p_frame = Vector<uint8_t>();
+}
+
+void VisualScriptLanguage::_advance_resume_timers() {
+	VisualScriptLanguage *language = singleton;
+	SceneTree *tree = SceneTree::get_singleton();
+	if (!language || !tree) {
+		return;
+	}
+
+	// Process time is already scaled, and timers keep running while paused.
+	LocalVector<Ref<VisualScriptFunctionState>> &expired =
+			language->resume_timers_expired;
+	{
+		MutexLock mutex_lock(language->lock);
+		language->resume_timers.advance(tree->get_process_time(), expired);
+	}
+
+	for (uint32_t i = 0; i < expired.size(); i++) {
+		if (expired[i]->is_valid()) {
+			expired[i]->_resume(Variant());
+			language->_recycle_function_state(expired[i]);
+		}
+	}
+
+	expired.clear();
+}
+
 String VisualScriptLanguage::get_type() const { return "VisualScript"; }
 
 String VisualScriptLanguage::get_extension() const { return "vs"; }
 
-void VisualScriptLanguage::finish() {}
+void VisualScriptLanguage::finish() {
+	uint64_t created = function_states_created.get();
+	uint64_t reused = function_states_reused.get();
+	if (created + reused > 0) {
+		print_verbose(vformat("VisualScript: Reused %d of %d function states (%d%%).",
+				reused, created + reused, reused * 100 / (created + reused)));
+	}
+}
 
 /* EDITOR FUNCTIONS */
 void VisualScriptLanguage::get_reserved_words(List<String> *p_words) const {}
@@ -2491,8 +3668,7 @@ bool VisualScriptLanguage::debug_break_parse(const String &p_file, int p_node,
 		const String &p_error) {
 	// Break because of parse error.
 
-	if (EngineDebugger::is_active() &&
-			Thread::get_caller_id() == Thread::get_main_id()) {
+	if (EngineDebugger::is_active()) {
 		_debug_parse_err_node = p_node;
 		_debug_parse_err_file = p_file;
 		_debug_error = p_error;
@@ -2505,8 +3681,7 @@ bool VisualScriptLanguage::debug_break_parse(const String &p_file, int p_node,
 
 bool VisualScriptLanguage::debug_break(const String &p_error,
 		bool p_allow_continue) {
-	if (EngineDebugger::is_active() &&
-			Thread::get_caller_id() == Thread::get_main_id()) {
+	if (EngineDebugger::is_active()) {
 		_debug_parse_err_node = -1;
 		_debug_parse_err_file = "";
 		_debug_error = p_error;
@@ -2524,7 +3699,7 @@ int VisualScriptLanguage::debug_get_stack_level_count() const {
 		return 1;
 	}
 
-	return _debug_call_stack_pos;
+	return _call_stack.pos;
 }
 
 int VisualScriptLanguage::debug_get_stack_level_line(int p_level) const {
@@ -2532,11 +3707,11 @@ int VisualScriptLanguage::debug_get_stack_level_line(int p_level) const {
 		return _debug_parse_err_node;
 	}
 
-	ERR_FAIL_INDEX_V(p_level, _debug_call_stack_pos, -1);
+	ERR_FAIL_INDEX_V(p_level, _call_stack.pos, -1);
 
-	int l = _debug_call_stack_pos - p_level - 1;
+	int l = _call_stack.pos - p_level - 1;
 
-	return *(_call_stack[l].current_id);
+	return _call_stack.levels[l].instance->plan->node_records[*_call_stack.levels[l].current_node].id;
 }
 
 String VisualScriptLanguage::debug_get_stack_level_function(int p_level) const {
@@ -2544,9 +3719,9 @@ String VisualScriptLanguage::debug_get_stack_level_function(int p_level) const {
 		return "";
 	}
 
-	ERR_FAIL_INDEX_V(p_level, _debug_call_stack_pos, "");
-	int l = _debug_call_stack_pos - p_level - 1;
-	return *_call_stack[l].function;
+	ERR_FAIL_INDEX_V(p_level, _call_stack.pos, "");
+	int l = _call_stack.pos - p_level - 1;
+	return *_call_stack.levels[l].function;
 }
 
 String VisualScriptLanguage::debug_get_stack_level_source(int p_level) const {
@@ -2554,9 +3729,9 @@ String VisualScriptLanguage::debug_get_stack_level_source(int p_level) const {
 		return _debug_parse_err_file;
 	}
 
-	ERR_FAIL_INDEX_V(p_level, _debug_call_stack_pos, "");
-	int l = _debug_call_stack_pos - p_level - 1;
-	return _call_stack[l].instance->get_script_ptr()->get_path();
+	ERR_FAIL_INDEX_V(p_level, _call_stack.pos, "");
+	int l = _call_stack.pos - p_level - 1;
+	return _call_stack.levels[l].instance->get_script_ptr()->get_path();
 }
 
 void VisualScriptLanguage::debug_get_stack_level_locals(int p_level,
@@ -2568,22 +3743,29 @@ void VisualScriptLanguage::debug_get_stack_level_locals(int p_level,
 		return;
 	}
 
-	ERR_FAIL_INDEX(p_level, _debug_call_stack_pos);
+	ERR_FAIL_INDEX(p_level, _call_stack.pos);
 
-	int l = _debug_call_stack_pos - p_level - 1;
-	const StringName *f = _call_stack[l].function;
+	int l = _call_stack.pos - p_level - 1;
+	const StringName *f = _call_stack.levels[l].function;
 
-	ERR_FAIL_COND(!_call_stack[l].instance->functions.has(*f));
+	const VisualScriptCompiledPlan *plan = _call_stack.levels[l].instance->plan.ptr();
+	ERR_FAIL_COND(!plan->functions.has(*f));
 
-	VisualScriptNodeInstance *node =
-			_call_stack[l].instance->instances[*_call_stack[l].current_id];
-	ERR_FAIL_COND(!node);
+	int current_node = *_call_stack.levels[l].current_node;
+	ERR_FAIL_INDEX(current_node, plan->node_count);
+	const VisualScriptCompiledPlan::NodeRecord &node =
+			plan->node_records[current_node];
+	const int *input_ports = plan->index_table + node.input_port_ofs;
+	const int *output_ports = plan->index_table + node.output_port_ofs;
+	VisualScriptNodeInstance *node_instance =
+			_call_stack.levels[l].instance->instances[current_node];
+	ERR_FAIL_COND(!node_instance);
 
 	p_locals->push_back("node_name");
-	p_values->push_back(node->get_base_node()->get_text());
+	p_values->push_back(node.node->get_text());
 
-	for (int i = 0; i < node->input_port_count; i++) {
-		String input_port_name = node->get_base_node()->get_input_value_port_info(i).name;
+	for (int i = 0; i < node.input_port_count; i++) {
+		String input_port_name = node.node->get_input_value_port_info(i).name;
 		if (input_port_name.is_empty()) {
 			input_port_name = "in_" + itos(i);
 		}
@@ -2592,18 +3774,18 @@ void VisualScriptLanguage::debug_get_stack_level_locals(int p_level,
 
 		// value is trickier
 
-		int in_from = node->input_ports[i];
+		int in_from = input_ports[i];
 		int in_value = in_from & VisualScriptNodeInstance::INPUT_MASK;
 
 		if (in_from & VisualScriptNodeInstance::INPUT_DEFAULT_VALUE_BIT) {
-			p_values->push_back(_call_stack[l].instance->default_values[in_value]);
+			p_values->push_back(plan->default_values[in_value]);
 		} else {
-			p_values->push_back(_call_stack[l].stack[in_value]);
+			p_values->push_back(_call_stack.levels[l].stack[in_value]);
 		}
 	}
 
-	for (int i = 0; i < node->output_port_count; i++) {
-		String output_port_name = node->get_base_node()->get_output_value_port_info(i).name;
+	for (int i = 0; i < node.output_port_count; i++) {
+		String output_port_name = node.node->get_output_value_port_info(i).name;
 		if (output_port_name.is_empty()) {
 			output_port_name = "out_" + itos(i);
 		}
@@ -2612,13 +3794,13 @@ void VisualScriptLanguage::debug_get_stack_level_locals(int p_level,
 
 		// value is trickier
 
-		int in_from = node->output_ports[i];
-		p_values->push_back(_call_stack[l].stack[in_from]);
+		int in_from = output_ports[i];
+		p_values->push_back(_call_stack.levels[l].stack[in_from]);
 	}
 
-	for (int i = 0; i < node->get_working_memory_size(); i++) {
+	for (int i = 0; i < node_instance->get_working_memory_size(); i++) {
 		p_locals->push_back("working_mem/mem_" + itos(i));
-		p_values->push_back((*_call_stack[l].work_mem)[i]);
+		p_values->push_back((*_call_stack.levels[l].work_mem)[i]);
 	}
 }
 
@@ -2629,10 +3811,10 @@ void VisualScriptLanguage::debug_get_stack_level_members(
 		return;
 	}
 
-	ERR_FAIL_INDEX(p_level, _debug_call_stack_pos);
-	int l = _debug_call_stack_pos - p_level - 1;
+	ERR_FAIL_INDEX(p_level, _call_stack.pos);
+	int l = _call_stack.pos - p_level - 1;
 
-	Ref<VisualScript> vs = _call_stack[l].instance->get_script();
+	Ref<VisualScript> vs = _call_stack.levels[l].instance->get_script();
 	if (vs.is_null()) {
 		return;
 	}
@@ -2641,7 +3823,7 @@ void VisualScriptLanguage::debug_get_stack_level_members(
 	vs->get_variable_list(&vars);
 	for (const StringName &E : vars) {
 		Variant v;
-		if (_call_stack[l].instance->get_variable(E, &v)) {
+		if (_call_stack.levels[l].instance->get_variable(E, &v)) {
 			p_members->push_back("variables/" + E);
 			p_values->push_back(v);
 		}
@@ -2682,21 +3864,101 @@ void VisualScriptLanguage::get_public_constants(
 void VisualScriptLanguage::get_public_annotations(
 		List<MethodInfo> *p_annotations) const {}
 
-void VisualScriptLanguage::profiling_start() {}
+void VisualScriptLanguage::profile_add(
+		VisualScriptCompiledPlan::Profile *p_profile) {
+	MutexLock mutex_lock(lock);
+	profile_list.add(&p_profile->profile_list);
+}
+
+void VisualScriptLanguage::frame() {
+	if (!profiling) {
+		return;
+	}
+
+	MutexLock mutex_lock(lock);
+
+	for (SelfList<VisualScriptCompiledPlan::Profile> *E = profile_list.first();
+			E; E = E->next()) {
+		VisualScriptCompiledPlan::Profile *profile = E->self();
+		profile->last_frame_call_count = profile->frame_call_count.get();
+		profile->last_frame_self_time = profile->frame_self_time.get();
+		profile->last_frame_total_time = profile->frame_total_time.get();
+		profile->frame_call_count.set(0);
+		profile->frame_self_time.set(0);
+		profile->frame_total_time.set(0);
+	}
+}
+
+void VisualScriptLanguage::profiling_start() {
+	MutexLock mutex_lock(lock);
+
+	for (SelfList<VisualScriptCompiledPlan::Profile> *E = profile_list.first();
+			E; E = E->next()) {
+		VisualScriptCompiledPlan::Profile *profile = E->self();
+		profile->call_count.set(0);
+		profile->self_time.set(0);
+		profile->total_time.set(0);
+		profile->frame_call_count.set(0);
+		profile->frame_self_time.set(0);
+		profile->frame_total_time.set(0);
+		profile->last_frame_call_count = 0;
+		profile->last_frame_self_time = 0;
+		profile->last_frame_total_time = 0;
+	}
+
+	profiling = true;
+}
 
-void VisualScriptLanguage::profiling_stop() {}
+void VisualScriptLanguage::profiling_stop() {
+	MutexLock mutex_lock(lock);
+	profiling = false;
+}
 
 int VisualScriptLanguage::profiling_get_accumulated_data(
 		ProfilingInfo *p_info_arr, int p_info_max) {
-	return 0;
+	MutexLock mutex_lock(lock);
+
+	int current = 0;
+	for (SelfList<VisualScriptCompiledPlan::Profile> *E = profile_list.first();
+			E && current < p_info_max; E = E->next()) {
+		VisualScriptCompiledPlan::Profile *profile = E->self();
+		p_info_arr[current].signature = profile->signature;
+		p_info_arr[current].call_count = profile->call_count.get();
+		p_info_arr[current].self_time = profile->self_time.get();
+		p_info_arr[current].total_time = profile->total_time.get();
+		current++;
+	}
+
+	return current;
 }
 
 int VisualScriptLanguage::profiling_get_frame_data(ProfilingInfo *p_info_arr,
 		int p_info_max) {
-	return 0;
+	MutexLock mutex_lock(lock);
+
+	int current = 0;
+	for (SelfList<VisualScriptCompiledPlan::Profile> *E = profile_list.first();
+			E && current < p_info_max; E = E->next()) {
+		VisualScriptCompiledPlan::Profile *profile = E->self();
+		if (profile->last_frame_call_count == 0) {
+			continue;
+		}
+
+		p_info_arr[current].signature = profile->signature;
+		p_info_arr[current].call_count = profile->last_frame_call_count;
+		p_info_arr[current].self_time = profile->last_frame_self_time;
+		p_info_arr[current].total_time = profile->last_frame_total_time;
+		current++;
+	}
+
+	return current;
 }
 
 VisualScriptLanguage *VisualScriptLanguage::singleton = nullptr;
+thread_local VisualScriptLanguage::CallStack VisualScriptLanguage::_call_stack;
+thread_local int VisualScriptLanguage::_debug_parse_err_node = -1;
+thread_local String VisualScriptLanguage::_debug_parse_err_file;
+thread_local String VisualScriptLanguage::_debug_error;
 
 void VisualScriptLanguage::add_register_func(
 		const String &p_name, VisualScriptNodeRegisterFunc p_func) {
@@ -2734,18 +3996,31 @@ VisualScriptLanguage::VisualScriptLanguage() {
 	if (EngineDebugger::is_active()) {
 		// Debugging enabled!
 		_debug_max_call_stack = dmcs;
-		_call_stack = memnew_arr(CallLevel, _debug_max_call_stack + 1);
-
 	} else {
 		_debug_max_call_stack = 0;
-		_call_stack = nullptr;
 	}
 }
 
 VisualScriptLanguage::~VisualScriptLanguage() {
-	if (_call_stack) {
-		memdelete_arr(_call_stack);
+	// Stacks of other threads go away with their threads.
+	_call_stack.free();
+
+	for (int i = 0; i < FRAME_RESUME_MAX; i++) {
+		frame_resume_queues[i][0].clear();
+		frame_resume_queues[i][1].clear();
+	}
+	resume_timers.clear();
+	resume_timers_expired.clear();
+	signal_resumed_states[0].clear();
+	signal_resumed_states[1].clear();
+	function_state_pool.clear();
+	yield_frame_pool.clear();
+
+	// Plans outliving the language must not touch the list anymore.
+	while (profile_list.first()) {
+		profile_list.remove(profile_list.first());
 	}
+
 	singleton = nullptr;
 }
 
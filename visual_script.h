@@ -36,8 +36,13 @@
 #include "core/doc_data.h"
 #include "core/object/script_language.h"
 #include "core/os/thread.h"
+#include "core/templates/local_vector.h"
 #include "core/templates/rb_set.h"
+#include "core/templates/safe_refcount.h"
+#include "core/templates/self_list.h"
 
+class Node;
+class SceneTree;
 class VisualScriptInstance;
 class VisualScriptNodeInstance;
 class VisualScript;
@@ -102,10 +107,189 @@ public:
 	VisualScriptNode();
 };
 
+// Immutable result of compiling the function graphs of a VisualScript.
+// It is built once per script and shared by all of its instances, which
+// only keep the mutable state (member variables and node instances).
+class VisualScriptCompiledPlan : public RefCounted {
+	GDCLASS(VisualScriptCompiledPlan, RefCounted);
+
+	friend class VisualScript;
+	friend class VisualScriptInstance;
+	friend class VisualScriptLanguage; // For debugger.
+
+public:
+	// Node as built by the compiler passes, discarded once linked.
+	struct NodeInfo {
+		int id = 0;
+		int sequence_index = 0;
+		int working_mem_idx = -1;
+		int working_mem_size = 0;
+		VisualScriptNode *node = nullptr;
+		Vector<int> input_ports;
+		Vector<int> output_ports;
+		Vector<int> sequence_outputs; // Node indices, -1 if the flow ends there.
+		Vector<int> dependencies; // Node indices.
+		// Dependencies to step before this node, flattened in the order they
+		// must run. Only set for nodes the sequence flow steps.
+		Vector<int> schedule;
+	};
+
+	// Node as laid out for running. Ports, sequence outputs and schedule are
+	// ranges of the index table.
+	struct NodeRecord {
+		int id;
+		int sequence_index;
+		int working_mem_idx;
+		int input_port_ofs;
+		int input_port_count;
+		int output_port_ofs;
+		int output_port_count;
+		int sequence_output_ofs;
+		int sequence_output_count;
+		int schedule_ofs;
+		int schedule_size;
+		// End of the stack slots written by stepping the node, its schedule
+		// included. Calls only clear what the nodes they stepped wrote.
+		int stack_end;
+		VisualScriptNode *node;
+	};
+
+	// Profiler data of a function, times in microseconds.
+	struct Profile {
+		StringName signature;
+		SafeNumeric<uint64_t> call_count;
+		SafeNumeric<uint64_t> self_time;
+		SafeNumeric<uint64_t> total_time;
+		SafeNumeric<uint64_t> frame_call_count;
+		SafeNumeric<uint64_t> frame_self_time;
+		SafeNumeric<uint64_t> frame_total_time;
+		uint64_t last_frame_call_count = 0;
+		uint64_t last_frame_self_time = 0;
+		uint64_t last_frame_total_time = 0;
+
+		SelfList<Profile> profile_list;
+
+		Profile() :
+				profile_list(this) {}
+	};
+
+	struct Function {
+		int node = 0; // Index of the VisualScriptFunction node.
+		int max_stack = 0;
+		int trash_pos = 0;
+		int flow_stack_size = 0;
+		int node_count = 0;
+		int argument_count = 0;
+		bool can_yield = false; // Its frame is allocated on the heap.
+		Profile *profile = nullptr; // Owned by the plan.
+	};
+
+	struct NodeCounter {
+		SafeNumeric<uint64_t> step_count;
+		SafeNumeric<uint64_t> step_time; // Microseconds.
+	};
+
+private:
+	Vector<NodeInfo> nodes; // Only while compiling.
+	HashMap<StringName, Function> functions;
+
+	// Node records followed by the index table, in a single allocation.
+	uint8_t *data = nullptr;
+	const NodeRecord *node_records = nullptr;
+	const int *index_table = nullptr;
+	int node_count = 0;
+
+	HashMap<StringName, int> variable_slots; // Member variable values, by name.
+
+	Vector<Variant> default_values;
+	int max_input_args = 0;
+	int max_output_args = 0;
+	size_t instance_arena_size = 0; // Bytes taken by the node instances.
+
+	// Indexed like the node records, allocated once node profiling is on.
+	NodeCounter *node_counters = nullptr;
+	SafeFlag node_profiling;
+
+	void _link();
+	void _set_node_profiling(bool p_enabled);
+
+public:
+	// Folded constants are shared by every call and instance, so values of
+	// reference types (which callees could modify) can't be folded.
+	static bool is_foldable_value(const Variant &p_value) {
+		switch (p_value.get_type()) {
+			case Variant::OBJECT:
+			case Variant::CALLABLE:
+			case Variant::SIGNAL:
+			case Variant::DICTIONARY:
+			case Variant::ARRAY:
+				return false;
+			default: {
+			}
+		}
+
+		return p_value.get_type() < Variant::PACKED_BYTE_ARRAY;
+	}
+
+	~VisualScriptCompiledPlan();
+};
+
+// Bump allocator owning the node instances of a VisualScriptInstance, so
+// they are allocated together and freed in one go.
+class VisualScriptNodeArena {
+	struct Chunk {
+		Chunk *next = nullptr;
+		size_t size = 0;
+		size_t used = 0;
+	};
+
+	Chunk *chunks = nullptr;
+
+	static size_t _align(size_t p_size) {
+		return (p_size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	}
+	static size_t _header_size() { return _align(sizeof(Chunk)); }
+
+public:
+	static size_t get_allocation_size(size_t p_size) { return _align(p_size); }
+
+	void reserve(size_t p_size);
+	void *alloc(size_t p_size);
+	void clear();
+
+	~VisualScriptNodeArena() { clear(); }
+};
+
+// Resolves a NodePath from a node and remembers the result. A cached node is
+// checked against the path by following its parents back to the source node,
+// which only compares names, so renames and reparenting of the nodes on the
+// path are caught while changes elsewhere in the tree cost nothing.
+struct VisualScriptNodePathCache {
+	ObjectID from;
+	ObjectID node;
+
+	static bool is_node_at_path(Node *p_from, const NodePath &p_path,
+			Node *p_node);
+	Node *get_node(Node *p_from, const NodePath &p_path);
+};
+
+// Node instances belong to a script instance and only run in one thread at a
+// time, see VisualScriptInstance. State of a single call (inputs, outputs, flow)
+// goes in the working memory, fields are for state shared by all calls, like
+// caches filled on first use. Compiled plans and what they hold are never
+// written once built, and are shared between threads.
 class VisualScriptNodeInstance {
+	friend class VisualScript; // For compiling.
 	friend class VisualScriptInstance;
 	friend class VisualScriptLanguage; // For debugger.
 
+	// While set, memnew() of node instances in this thread takes memory from
+	// the arena, such instances must be destroyed without memdelete().
+	static thread_local VisualScriptNodeArena *allocation_arena;
+	// While set, memnew() of node instances in this thread adds the arena
+	// space they would take.
+	static thread_local size_t *allocation_size;
+
 	enum { // Input argument addressing.
 		INPUT_SHIFT = 1 << 24,
 		INPUT_MASK = INPUT_SHIFT - 1,
@@ -114,16 +298,7 @@ class VisualScriptNodeInstance {
 	};
 
 	int id = 0;
-	int sequence_index = 0;
-	VisualScriptNodeInstance **sequence_outputs = nullptr;
-	int sequence_output_count = 0;
-	Vector<VisualScriptNodeInstance *> dependencies;
-	int *input_ports = nullptr;
-	int input_port_count = 0;
-	int *output_ports = nullptr;
-	int output_port_count = 0;
-	int working_mem_idx = 0;
-	int pass_idx = 0;
+	int index = 0; // Index of the node in the compiled plan.
 
 	VisualScriptNode *base = nullptr;
 
@@ -151,15 +326,11 @@ public:
 
 	};
 
-	_FORCE_INLINE_ int get_input_port_count() const { return input_port_count; }
-	_FORCE_INLINE_ int get_output_port_count() const { return output_port_count; }
-	_FORCE_INLINE_ int get_sequence_output_count() const {
-		return sequence_output_count;
-	}
-
 	_FORCE_INLINE_ int get_id() const { return id; }
 
 	virtual int get_working_memory_size() const { return 0; }
+	// Whether step() may return STEP_YIELD_BIT.
+	virtual bool can_yield() const { return false; }
 
 	virtual int
 	step(const Variant **p_inputs, Variant **p_outputs, StartMode p_start_mode,
@@ -169,6 +340,10 @@ public:
 
 	Ref<VisualScriptNode> get_base_node() { return Ref<VisualScriptNode>(base); }
 
+	static void *operator new(size_t p_size, const char *p_description);
+	static void operator delete(void *p_mem, const char *p_description);
+	static void operator delete(void *p_mem);
+
 	VisualScriptNodeInstance();
 	virtual ~VisualScriptNodeInstance();
 };
@@ -192,6 +367,10 @@ public:
 		bool operator<(const SequenceConnection &p_connection) const {
 			return id < p_connection.id;
 		}
+
+		bool operator==(const SequenceConnection &p_connection) const {
+			return id == p_connection.id;
+		}
 	};
 
 	struct DataConnection {
@@ -208,6 +387,10 @@ public:
 		bool operator<(const DataConnection &p_connection) const {
 			return id < p_connection.id;
 		}
+
+		bool operator==(const DataConnection &p_connection) const {
+			return id == p_connection.id;
+		}
 	};
 
 private:
@@ -229,6 +412,21 @@ private:
 	RBSet<SequenceConnection> sequence_connections;
 	RBSet<DataConnection> data_connections;
 
+	// Per-node adjacency lists, kept in sync with the connection sets.
+	struct NodeConnections {
+		Vector<SequenceConnection> sequence_outputs;
+		Vector<SequenceConnection> sequence_inputs;
+		Vector<DataConnection> data_outputs;
+		Vector<DataConnection> data_inputs;
+	};
+
+	HashMap<int, NodeConnections> node_connections;
+
+	void _add_sequence_connection(const SequenceConnection &p_connection);
+	void _remove_sequence_connection(const SequenceConnection &p_connection);
+	void _add_data_connection(const DataConnection &p_connection);
+	void _remove_data_connection(const DataConnection &p_connection);
+
 	Vector2 scroll;
 
 	struct Function {
@@ -249,6 +447,8 @@ private:
 	Dictionary rpc_functions;
 
 	HashMap<Object *, VisualScriptInstance *> instances;
+	Ref<VisualScriptCompiledPlan> compiled_plan;
+	bool node_profiling = false;
 
 	bool is_tool_script;
 
@@ -266,6 +466,24 @@ private:
 	void _set_data(const Dictionary &p_data);
 	Dictionary _get_data() const;
 
+	Ref<VisualScriptCompiledPlan> _compile_plan();
+
+	struct StackLifetime {
+		int stamp = -1; // Schedule that last wrote the value.
+		int begin = 0;
+		int end = 0;
+	};
+	static void
+	_visit_dependencies(const VisualScriptCompiledPlan::NodeInfo *p_nodes,
+			int p_node, int p_first_index, int p_root, int *r_visited,
+			Vector<int> &r_schedule);
+	void _build_schedules(VisualScriptCompiledPlan *p_plan, int p_first_index,
+			const VisualScriptCompiledPlan::Function &p_function) const;
+	void _fold_constants(VisualScriptCompiledPlan *p_plan, int p_first_index,
+			const VisualScriptCompiledPlan::Function &p_function) const;
+	void _share_stack_slots(VisualScriptCompiledPlan *p_plan, int p_first_index,
+			VisualScriptCompiledPlan::Function &r_function) const;
+
 protected:
 	void _node_ports_changed(int p_id);
 	static void _bind_methods();
@@ -355,6 +573,14 @@ public:
 
 	int get_available_id() const;
 
+	Ref<VisualScriptCompiledPlan> get_compiled_plan();
+	void invalidate_compiled_plan();
+
+	void set_node_profiling_enabled(bool p_enabled);
+	bool is_node_profiling_enabled() const;
+	Dictionary get_node_profile() const;
+	void reset_node_profile();
+
 	void set_instance_base_type(const StringName &p_type);
 
 	virtual bool can_instantiate() const override;
@@ -413,37 +639,25 @@ public:
 class VisualScriptInstance : public ScriptInstance {
 	Object *owner = nullptr;
 	Ref<VisualScript> script;
+	Ref<VisualScriptCompiledPlan> plan;
 
-	HashMap<StringName, Variant> variables; // Using variable path, not script.
-	HashMap<int, VisualScriptNodeInstance *> instances;
-
-	struct Function {
-		int node = 0;
-		int max_stack = 0;
-		int trash_pos = 0;
-		int flow_stack_size = 0;
-		int pass_stack_size = 0;
-		int node_count = 0;
-		int argument_count = 0;
-	};
-
-	HashMap<StringName, Function> functions;
-
-	Vector<Variant> default_values;
-	int max_input_args = 0;
-	int max_output_args = 0;
+	Vector<Variant> variables; // Indexed by the plan variable slots.
+	Vector<VisualScriptNodeInstance *> instances; // Indexed like the plan nodes.
+	VisualScriptNodeArena node_arena; // Owns the node instances.
 
 	StringName source;
 
-	void _dependency_step(VisualScriptNodeInstance *node, int p_pass,
-			int *pass_stack, const Variant **input_args,
-			Variant **output_args, Variant *variant_stack,
-			Callable::CallError &r_error, String &error_str,
-			VisualScriptNodeInstance **r_error_node);
+	// Member variables and node instances are not synchronized, so functions
+	// of an instance run in one thread at a time. Calls and resumes from other
+	// threads wait for the running one, nested calls in the same thread go on.
+	// Instances calling each other from two threads in opposite orders can
+	// deadlock, as with any pair of locks.
+	mutable Mutex call_lock;
+
 	Variant _call_internal(const StringName &p_method, void *p_stack,
-			int p_stack_size, VisualScriptNodeInstance *p_node,
-			int p_flow_stack_pos, int p_pass,
-			bool p_resuming_yield, Callable::CallError &r_error);
+			int p_stack_size, int p_node, int p_flow_stack_pos, int p_stack_used,
+			bool p_resuming_yield, Vector<uint8_t> *p_heap_frame,
+			Callable::CallError &r_error);
 
 	friend class VisualScriptFunctionState; // For yield.
 	friend class VisualScriptLanguage; // For debugger.
@@ -473,25 +687,35 @@ public:
 	virtual void notification(int p_notification);
 	String to_string(bool *r_valid);
 	bool set_variable(const StringName &p_variable, const Variant &p_value) {
-		HashMap<StringName, Variant>::Iterator E = variables.find(p_variable);
-		if (!E) {
+		int slot = get_variable_slot(p_variable);
+		if (slot < 0) {
 			return false;
 		}
 
-		E->value = p_value;
+		variables.write[slot] = p_value;
 		return true;
 	}
 
 	bool get_variable(const StringName &p_variable, Variant *r_variable) const {
-		HashMap<StringName, Variant>::ConstIterator E = variables.find(p_variable);
-		if (!E) {
+		int slot = get_variable_slot(p_variable);
+		if (slot < 0) {
 			return false;
 		}
 
-		*r_variable = E->value;
+		*r_variable = variables[slot];
 		return true;
 	}
 
+	// Slots are resolved once, nodes then access variables by slot.
+	int get_variable_slot(const StringName &p_variable) const {
+		const int *slot = plan->variable_slots.getptr(p_variable);
+		return slot ? *slot : -1;
+	}
+
+	_FORCE_INLINE_ Variant &get_variable_by_slot(int p_slot) {
+		return variables.write[p_slot];
+	}
+
 	virtual Ref<Script> get_script() const;
 
 	_FORCE_INLINE_ VisualScript *get_script_ptr() { return script.ptr(); }
@@ -510,6 +734,7 @@ public:
 class VisualScriptFunctionState : public RefCounted {
 	GDCLASS(VisualScriptFunctionState, RefCounted);
 	friend class VisualScriptInstance;
+	friend class VisualScriptLanguage; // For recycling.
 
 	ObjectID instance_id;
 	ObjectID script_id;
@@ -517,29 +742,83 @@ class VisualScriptFunctionState : public RefCounted {
 	StringName function;
 	Vector<uint8_t> stack;
 	int working_mem_index = 0;
-	int variant_stack_size = 0;
-	VisualScriptNodeInstance *node = nullptr;
+	int variant_stack_size = 0; // Leading variants that may hold values.
+	int node = 0;
 	int flow_stack_pos = 0;
-	int pass = 0;
+	int signal_argument_count = 0;
 
 	Variant _signal_callback(const Variant **p_args, int p_argcount,
 			Callable::CallError &r_error);
+	Variant _signal_resume(const Variant **p_args, int p_argcount,
+			Callable::CallError &r_error);
+	// Puts p_working_mem in the working memory of the yielding node and runs
+	// the rest of the function.
+	Variant _resume(const Variant &p_working_mem);
 
 protected:
 	static void _bind_methods();
 
 public:
 	void connect_to_signal(Object *p_obj, const String &p_signal, Array p_binds);
+	// Resumes on the signal, its arguments go to the working memory of the
+	// yielding node, after the state.
+	void connect_signal_resume(Object *p_obj, const StringName &p_signal,
+			int p_argument_count);
 	bool is_valid() const;
 	Variant resume(Array p_args);
 	VisualScriptFunctionState();
 	~VisualScriptFunctionState();
 };
 
+// Hierarchical timer wheel of states yielding for a while. Deadlines are
+// placed by tick (1/64 s): the first level has a slot per tick of the current
+// 4 second block, the second a slot per block of the current 256 seconds, and
+// later ones wait in a list. Entries move down a level as their block starts.
+class VisualScriptTimerWheel {
+	enum {
+		TICKS_PER_SECOND = 64,
+		LEVEL0_BITS = 8,
+		LEVEL1_BITS = 6,
+		LEVEL0_SIZE = 1 << LEVEL0_BITS,
+		LEVEL1_SIZE = 1 << LEVEL1_BITS,
+	};
+
+	struct Entry {
+		double deadline = 0.0;
+		Ref<VisualScriptFunctionState> state;
+	};
+
+	LocalVector<Entry> level0[LEVEL0_SIZE];
+	LocalVector<Entry> level1[LEVEL1_SIZE];
+	LocalVector<Entry> overflow;
+
+	double time = 0.0;
+	uint64_t tick = 0; // First tick with entries possibly not expired.
+	uint64_t cascaded_tick = 0;
+	uint32_t count = 0;
+
+	static uint64_t _get_tick(double p_time) {
+		return (uint64_t)(p_time * TICKS_PER_SECOND);
+	}
+
+	void _insert(const Entry &p_entry);
+	void _cascade(LocalVector<Entry> &p_list);
+
+public:
+	void add(double p_wait, const Ref<VisualScriptFunctionState> &p_state);
+	// Moves time forward, adding the states whose deadline passed to r_expired.
+	void advance(double p_delta,
+			LocalVector<Ref<VisualScriptFunctionState>> &r_expired);
+	uint32_t size() const { return count; }
+	void clear();
+};
+
 typedef Ref<VisualScriptNode> (*VisualScriptNodeRegisterFunc)(
 		const String &p_type);
 
 class VisualScriptLanguage : public ScriptLanguage {
+	friend class VisualScriptFunctionState; // For recycling.
+
 	HashMap<String, VisualScriptNodeRegisterFunc> register_funcs;
 
 	struct CallLevel {
@@ -547,15 +826,83 @@ class VisualScriptLanguage : public ScriptLanguage {
 		Variant **work_mem = nullptr;
 		const StringName *function = nullptr;
 		VisualScriptInstance *instance = nullptr;
-		int *current_id = nullptr;
+		int *current_node = nullptr; // Index in the compiled plan.
 	};
 
-	int _debug_parse_err_node = -1;
-	String _debug_parse_err_file = "";
-	String _debug_error;
-	int _debug_call_stack_pos = 0;
+	// Per thread, like the call stack. The debugger reads them from the
+	// thread that broke.
+	static thread_local int _debug_parse_err_node;
+	static thread_local String _debug_parse_err_file;
+	static thread_local String _debug_error;
 	int _debug_max_call_stack;
-	CallLevel *_call_stack = nullptr;
+
+	// Functions can run in any thread, so each thread keeps its own levels,
+	// allocated on its first call.
+	struct CallStack {
+		CallLevel *levels = nullptr;
+		int pos = 0;
+
+		void free() {
+			if (levels) {
+				memdelete_arr(levels);
+				levels = nullptr;
+			}
+			pos = 0;
+		}
+
+		~CallStack() { free(); }
+	};
+
+	static thread_local CallStack _call_stack;
+
+	SelfList<VisualScriptCompiledPlan::Profile>::List profile_list;
+
+	// States yielding until the next process or physics frame. Each type has
+	// two queues, yields go to the current one while the other is resumed.
+	enum {
+		FRAME_RESUME_PROCESS,
+		FRAME_RESUME_PHYSICS,
+		FRAME_RESUME_MAX
+	};
+
+	ObjectID frame_resume_tree;
+	LocalVector<Ref<VisualScriptFunctionState>> frame_resume_queues[FRAME_RESUME_MAX][2];
+	int frame_resume_current[FRAME_RESUME_MAX] = {};
+
+	void _resume_frame_queue(int p_type);
+	void _process_frame() { _resume_frame_queue(FRAME_RESUME_PROCESS); }
+	void _physics_frame() { _resume_frame_queue(FRAME_RESUME_PHYSICS); }
+
+	// States waiting for a time, advanced with the process time once the scene
+	// tree is done with the frame, like the timers of SceneTree::create_timer().
+	VisualScriptTimerWheel resume_timers;
+	LocalVector<Ref<VisualScriptFunctionState>> resume_timers_expired;
+	bool resume_timers_registered = false;
+
+	static void _advance_resume_timers();
+
+	// Finished function states and frames of yielding functions, for later
+	// yields to reuse.
+	enum {
+		FUNCTION_STATE_POOL_MAX = 1024,
+	};
+
+	LocalVector<Ref<VisualScriptFunctionState>> function_state_pool;
+	LocalVector<Vector<uint8_t>> yield_frame_pool;
+
+	void _recycle_function_state(const Ref<VisualScriptFunctionState> &p_state);
+
+	// States resumed by a signal are recycled once the scene tree is done with
+	// the frame. The emission resuming them removes their one-shot connection
+	// only after all its slots ran, and a state reused before that could not
+	// connect again. Like the frame queues, one list fills while the other is
+	// recycled.
+	LocalVector<Ref<VisualScriptFunctionState>> signal_resumed_states[2];
+	int signal_resumed_current = 0;
+	bool signal_resumed_registered = false;
+
+	void _recycle_after_emission(const Ref<VisualScriptFunctionState> &p_state);
+	static void _recycle_signal_resumed_states();
 
 public:
 	StringName notification = "_notification";
@@ -567,6 +914,21 @@ public:
 
 	Mutex lock;
 
+	bool profiling = false;
+	void profile_add(VisualScriptCompiledPlan::Profile *p_profile);
+
+	void queue_frame_resume(SceneTree *p_tree, bool p_physics,
+			const Ref<VisualScriptFunctionState> &p_state);
+	void queue_timer_resume(double p_wait,
+			const Ref<VisualScriptFunctionState> &p_state);
+
+	SafeNumeric<uint64_t> function_states_created;
+	SafeNumeric<uint64_t> function_states_reused;
+
+	Ref<VisualScriptFunctionState> create_function_state();
+	void acquire_yield_frame(Vector<uint8_t> &r_frame, int p_size);
+	void release_yield_frame(Vector<uint8_t> &p_frame);
+
 	bool debug_break(const String &p_error, bool p_allow_continue = true);
 	bool debug_break_parse(const String &p_file, int p_node,
 			const String &p_error);
@@ -574,9 +936,9 @@ public:
 	_FORCE_INLINE_ void enter_function(VisualScriptInstance *p_instance,
 			const StringName *p_function,
 			Variant *p_stack, Variant **p_work_mem,
-			int *current_id) {
-		if (Thread::get_main_id() != Thread::get_caller_id()) {
-			return; // No support for other threads than main for now.
+			int *p_current_node) {
+		if (unlikely(_call_stack.levels == nullptr)) {
+			_call_stack.levels = memnew_arr(CallLevel, _debug_max_call_stack + 1);
 		}
 
 		if (EngineDebugger::get_script_debugger()->get_lines_left() > 0 &&
@@ -585,7 +947,7 @@ public:
 					EngineDebugger::get_script_debugger()->get_depth() + 1);
 		}
 
-		if (_debug_call_stack_pos >= _debug_max_call_stack) {
+		if (_call_stack.pos >= _debug_max_call_stack) {
 			// Stack overflow.
 			_debug_error = vformat("Stack overflow (stack size: %s). Check for "
 								   "infinite recursion in your script.",
@@ -594,32 +956,29 @@ public:
 			return;
 		}
 
-		_call_stack[_debug_call_stack_pos].stack = p_stack;
-		_call_stack[_debug_call_stack_pos].instance = p_instance;
-		_call_stack[_debug_call_stack_pos].function = p_function;
-		_call_stack[_debug_call_stack_pos].work_mem = p_work_mem;
-		_call_stack[_debug_call_stack_pos].current_id = current_id;
-		_debug_call_stack_pos++;
+		CallLevel &level = _call_stack.levels[_call_stack.pos];
+		level.stack = p_stack;
+		level.instance = p_instance;
+		level.function = p_function;
+		level.work_mem = p_work_mem;
+		level.current_node = p_current_node;
+		_call_stack.pos++;
 	}
 
 	_FORCE_INLINE_ void exit_function() {
-		if (Thread::get_main_id() != Thread::get_caller_id()) {
-			return; // No support for other threads than main for now.
-		}
-
 		if (EngineDebugger::get_script_debugger()->get_lines_left() > 0 &&
 				EngineDebugger::get_script_debugger()->get_depth() >= 0) {
 			EngineDebugger::get_script_debugger()->set_depth(
 					EngineDebugger::get_script_debugger()->get_depth() - 1);
 		}
 
-		if (_debug_call_stack_pos == 0) {
+		if (_call_stack.pos == 0) {
 			_debug_error = "Stack underflow (engine bug), please report.";
 			EngineDebugger::get_script_debugger()->debug(this);
 			return;
 		}
 
-		_debug_call_stack_pos--;
+		_call_stack.pos--;
 	}
 
 	//////////////////////////////////////
@@ -699,6 +1058,8 @@ public:
 	virtual void
 	get_public_annotations(List<MethodInfo> *p_annotations) const override;
 
+	virtual void frame() override;
+
 	virtual void profiling_start() override;
 	virtual void profiling_stop() override;
 
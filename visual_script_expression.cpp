@@ -1229,273 +1229,514 @@ VisualScriptExpression::ENode *VisualScriptExpression::_parse_expression() {
 	return parse_expression[0].node;
 }
 
-bool VisualScriptExpression::_compile_expression() {
-	if (!expression_dirty) {
-		return error_set;
+int VisualScriptExpression::_emit_node(ENode *p_node, Program *p_program) {
+	// Inputs and constants are read in place, everything else gets a register.
+	switch (p_node->type) {
+		case ENode::TYPE_INPUT: {
+			const InputNode *in = static_cast<const InputNode *>(p_node);
+			return Program::make_address(Program::ADDRESS_TYPE_INPUT, in->index);
+		}
+		case ENode::TYPE_CONSTANT: {
+			const ConstantNode *c = static_cast<const ConstantNode *>(p_node);
+			p_program->constants.push_back(c->value);
+			return Program::make_address(Program::ADDRESS_TYPE_CONSTANT, p_program->constants.size() - 1);
+		}
+		default: {
+		}
 	}
 
-	if (nodes) {
-		memdelete(nodes);
-		nodes = nullptr;
-		root = nullptr;
+	Program::Instruction instruction;
+	// Operands are emitted first, so they are computed before this instruction.
+	Vector<int> operands;
+
+	switch (p_node->type) {
+		case ENode::TYPE_SELF: {
+			instruction.opcode = Program::Instruction::OPCODE_SELF;
+		} break;
+		case ENode::TYPE_OPERATOR: {
+			const OperatorNode *op = static_cast<const OperatorNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_OPERATOR;
+			instruction.op = op->op;
+			operands.push_back(_emit_node(op->nodes[0], p_program));
+			if (op->nodes[1]) {
+				operands.push_back(_emit_node(op->nodes[1], p_program));
+			}
+		} break;
+		case ENode::TYPE_INDEX: {
+			const IndexNode *index = static_cast<const IndexNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_INDEX;
+			operands.push_back(_emit_node(index->base, p_program));
+			operands.push_back(_emit_node(index->index, p_program));
+		} break;
+		case ENode::TYPE_NAMED_INDEX: {
+			const NamedIndexNode *index = static_cast<const NamedIndexNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_NAMED_INDEX;
+			instruction.name = index->name;
+			operands.push_back(_emit_node(index->base, p_program));
+		} break;
+		case ENode::TYPE_ARRAY: {
+			const ArrayNode *array = static_cast<const ArrayNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_ARRAY;
+			for (int i = 0; i < array->array.size(); i++) {
+				operands.push_back(_emit_node(array->array[i], p_program));
+			}
+		} break;
+		case ENode::TYPE_DICTIONARY: {
+			const DictionaryNode *dictionary = static_cast<const DictionaryNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_DICTIONARY;
+			for (int i = 0; i < dictionary->dict.size(); i++) {
+				operands.push_back(_emit_node(dictionary->dict[i], p_program));
+			}
+		} break;
+		case ENode::TYPE_CONSTRUCTOR: {
+			const ConstructorNode *constructor = static_cast<const ConstructorNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_CONSTRUCT;
+			instruction.data_type = constructor->data_type;
+			for (int i = 0; i < constructor->arguments.size(); i++) {
+				operands.push_back(_emit_node(constructor->arguments[i], p_program));
+			}
+			p_program->max_arguments = MAX(p_program->max_arguments, operands.size());
+		} break;
+		case ENode::TYPE_CALL: {
+			const CallNode *call = static_cast<const CallNode *>(p_node);
+			instruction.opcode = Program::Instruction::OPCODE_CALL;
+			instruction.name = call->method;
+			// Base first, then the arguments.
+			operands.push_back(_emit_node(call->base, p_program));
+			for (int i = 0; i < call->arguments.size(); i++) {
+				operands.push_back(_emit_node(call->arguments[i], p_program));
+			}
+			p_program->max_arguments = MAX(p_program->max_arguments, call->arguments.size());
+		} break;
+		default: {
+			ERR_FAIL_V_MSG(0, "Unexpected node in expression tree.");
+		}
 	}
 
-	error_str = String();
-	error_set = false;
-	str_ofs = 0;
+	instruction.operand_ofs = p_program->operands.size();
+	instruction.operand_count = operands.size();
+	p_program->operands.append_array(operands);
+	p_program->instructions.push_back(instruction);
 
-	root = _parse_expression();
+	return Program::make_address(Program::ADDRESS_TYPE_REGISTER, p_program->instructions.size() - 1);
+}
 
-	if (error_set) {
-		root = nullptr;
-		if (nodes) {
-			memdelete(nodes);
-		}
-		nodes = nullptr;
-		return true;
+void VisualScriptExpression::_clear_nodes() {
+	while (nodes) {
+		ENode *next = nodes->next;
+		nodes->~ENode();
+		nodes = next;
 	}
 
-	expression_dirty = false;
-	return false;
+	root = nullptr;
+	node_arena.clear();
 }
 
-class VisualScriptNodeInstanceExpression : public VisualScriptNodeInstance {
-public:
-	VisualScriptInstance *instance = nullptr;
-	VisualScriptExpression *expression = nullptr;
+// Values multiplication by a scalar commutes with.
+static bool _is_scalable_type(Variant::Type p_type) {
+	switch (p_type) {
+		case Variant::INT:
+		case Variant::FLOAT:
+		case Variant::VECTOR2:
+		case Variant::VECTOR3:
+		case Variant::VECTOR4:
+			return true;
+		default: {
+		}
+	}
 
-	// virtual int get_working_memory_size() const override { return 0; }
-	// execute by parsing the tree directly
-	virtual bool _execute(const Variant **p_inputs,
-			VisualScriptExpression::ENode *p_node, Variant &r_ret,
-			String &r_error_str, Callable::CallError &ce) {
-		switch (p_node->type) {
-			case VisualScriptExpression::ENode::TYPE_INPUT: {
-				const VisualScriptExpression::InputNode *in =
-						static_cast<const VisualScriptExpression::InputNode *>(p_node);
-				r_ret = *p_inputs[in->index];
-			} break;
-			case VisualScriptExpression::ENode::TYPE_CONSTANT: {
-				const VisualScriptExpression::ConstantNode *c =
-						static_cast<const VisualScriptExpression::ConstantNode *>(p_node);
-				r_ret = c->value;
+	return false;
+}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_SELF: {
-				r_ret = instance->get_owner_ptr();
-			} break;
-			case VisualScriptExpression::ENode::TYPE_OPERATOR: {
-				const VisualScriptExpression::OperatorNode *op =
-						static_cast<const VisualScriptExpression::OperatorNode *>(p_node);
-
-				Variant a;
-				bool ret = _execute(p_inputs, op->nodes[0], a, r_error_str, ce);
-				if (ret) {
-					return true;
-				}
+VisualScriptExpression::ENode *VisualScriptExpression::_fold_constants(ENode *p_node) {
+	switch (p_node->type) {
+		case ENode::TYPE_OPERATOR: {
+			OperatorNode *op = static_cast<OperatorNode *>(p_node);
+			op->nodes[0] = _fold_constants(op->nodes[0]);
+			if (op->nodes[1]) {
+				op->nodes[1] = _fold_constants(op->nodes[1]);
+			}
 
+			if (op->nodes[0]->type == ENode::TYPE_CONSTANT &&
+					(!op->nodes[1] || op->nodes[1]->type == ENode::TYPE_CONSTANT)) {
+				Variant a = static_cast<ConstantNode *>(op->nodes[0])->value;
 				Variant b;
-
 				if (op->nodes[1]) {
-					ret = _execute(p_inputs, op->nodes[1], b, r_error_str, ce);
-					if (ret) {
-						return true;
-					}
+					b = static_cast<ConstantNode *>(op->nodes[1])->value;
 				}
 
+				Variant r;
 				bool valid = true;
-				Variant::evaluate(op->op, a, b, r_ret, valid);
-				if (!valid) {
-					r_error_str = "Invalid operands to operator " +
-							Variant::get_operator_name(op->op) + ": " +
-							Variant::get_type_name(a.get_type()) + " and " +
-							Variant::get_type_name(b.get_type()) + ".";
-					return true;
+				Variant::evaluate(op->op, a, b, r, valid);
+				// Invalid operations are left to report their error when run.
+				if (valid && VisualScriptCompiledPlan::is_foldable_value(r)) {
+					ConstantNode *constant = alloc_node<ConstantNode>();
+					constant->value = r;
+					return constant;
 				}
+				return op;
+			}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_INDEX: {
-				const VisualScriptExpression::IndexNode *index =
-						static_cast<const VisualScriptExpression::IndexNode *>(p_node);
-
-				Variant expression_base;
-				bool ret = _execute(p_inputs, index->base, expression_base, r_error_str, ce);
-				if (ret) {
-					return true;
-				}
+			// (K * x) * C becomes (K * C) * x, when x is an input declared as a
+			// scalar, so scaling chains like Vector2(1, 0) * speed * 0.5 need a
+			// single multiplication.
+			if (op->op != Variant::OP_MULTIPLY || op->nodes[0]->type != ENode::TYPE_OPERATOR ||
+					op->nodes[1]->type != ENode::TYPE_CONSTANT) {
+				return op;
+			}
 
-				Variant idx;
+			OperatorNode *inner = static_cast<OperatorNode *>(op->nodes[0]);
+			if (inner->op != Variant::OP_MULTIPLY) {
+				return op;
+			}
 
-				ret = _execute(p_inputs, index->index, idx, r_error_str, ce);
-				if (ret) {
-					return true;
-				}
+			int constant_idx = inner->nodes[0]->type == ENode::TYPE_CONSTANT ? 0 : 1;
+			ENode *x = inner->nodes[1 - constant_idx];
+			if (inner->nodes[constant_idx]->type != ENode::TYPE_CONSTANT ||
+					x->type != ENode::TYPE_INPUT) {
+				return op;
+			}
 
-				bool valid;
-				r_ret = expression_base.get(idx, &valid);
-				if (!valid) {
-					r_error_str = "Invalid index of type " +
-							Variant::get_type_name(idx.get_type()) +
-							" for base of type " +
-							Variant::get_type_name(expression_base.get_type()) + ".";
-					return true;
-				}
+			Variant::Type x_type = inputs[static_cast<InputNode *>(x)->index].type;
+			const Variant &k = static_cast<ConstantNode *>(inner->nodes[constant_idx])->value;
+			const Variant &c = static_cast<ConstantNode *>(op->nodes[1])->value;
+			if ((x_type != Variant::INT && x_type != Variant::FLOAT) ||
+					!_is_scalable_type(k.get_type()) || !_is_scalable_type(c.get_type())) {
+				return op;
+			}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_NAMED_INDEX: {
-				const VisualScriptExpression::NamedIndexNode *index =
-						static_cast<const VisualScriptExpression::NamedIndexNode *>(p_node);
-
-				Variant typed_named_expression_base;
-				bool ret = _execute(p_inputs, index->base, typed_named_expression_base, r_error_str, ce);
-				if (ret) {
-					return true;
-				}
+			Variant r;
+			bool valid = true;
+			Variant::evaluate(Variant::OP_MULTIPLY, k, c, r, valid);
+			if (!valid) {
+				return op;
+			}
 
-				bool valid;
-				r_ret = typed_named_expression_base.get_named(index->name, valid);
-				if (!valid) {
-					r_error_str = "Invalid index '" + String(index->name) +
-							"' for base of type " +
-							Variant::get_type_name(typed_named_expression_base.get_type()) + ".";
-					return true;
-				}
+			ConstantNode *constant = alloc_node<ConstantNode>();
+			constant->value = r;
+			inner->nodes[0] = constant;
+			inner->nodes[1] = x;
+			return inner;
+		}
+		case ENode::TYPE_INDEX: {
+			IndexNode *index = static_cast<IndexNode *>(p_node);
+			index->base = _fold_constants(index->base);
+			index->index = _fold_constants(index->index);
+		} break;
+		case ENode::TYPE_NAMED_INDEX: {
+			NamedIndexNode *index = static_cast<NamedIndexNode *>(p_node);
+			index->base = _fold_constants(index->base);
+		} break;
+		case ENode::TYPE_ARRAY: {
+			ArrayNode *array = static_cast<ArrayNode *>(p_node);
+			for (int i = 0; i < array->array.size(); i++) {
+				array->array.write[i] = _fold_constants(array->array[i]);
+			}
+		} break;
+		case ENode::TYPE_DICTIONARY: {
+			DictionaryNode *dictionary = static_cast<DictionaryNode *>(p_node);
+			for (int i = 0; i < dictionary->dict.size(); i++) {
+				dictionary->dict.write[i] = _fold_constants(dictionary->dict[i]);
+			}
+		} break;
+		case ENode::TYPE_CONSTRUCTOR: {
+			ConstructorNode *constructor = static_cast<ConstructorNode *>(p_node);
+			bool all_constant = true;
+			for (int i = 0; i < constructor->arguments.size(); i++) {
+				constructor->arguments.write[i] = _fold_constants(constructor->arguments[i]);
+				all_constant = all_constant && constructor->arguments[i]->type == ENode::TYPE_CONSTANT;
+			}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_ARRAY: {
-				const VisualScriptExpression::ArrayNode *array =
-						static_cast<const VisualScriptExpression::ArrayNode *>(p_node);
-
-				Array arr;
-				arr.resize(array->array.size());
-				for (int i = 0; i < array->array.size(); i++) {
-					Variant value;
-					bool ret = _execute(p_inputs, array->array[i], value, r_error_str, ce);
-					if (ret) {
-						return true;
-					}
-					arr[i] = value;
-				}
+			if (!all_constant) {
+				break;
+			}
 
-				r_ret = arr;
+			Vector<const Variant *> argp;
+			argp.resize(constructor->arguments.size());
+			for (int i = 0; i < constructor->arguments.size(); i++) {
+				argp.write[i] = &static_cast<ConstantNode *>(constructor->arguments[i])->value;
+			}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_DICTIONARY: {
-				const VisualScriptExpression::DictionaryNode *dictionary =
-						static_cast<const VisualScriptExpression::DictionaryNode *>(p_node);
-
-				Dictionary d;
-				for (int i = 0; i < dictionary->dict.size(); i += 2) {
-					Variant key;
-					bool ret =
-							_execute(p_inputs, dictionary->dict[i + 0], key, r_error_str, ce);
-					if (ret) {
+			Variant r;
+			Callable::CallError ce;
+			Variant::construct(constructor->data_type, r, argp.ptrw(), argp.size(), ce);
+			if (ce.error == Callable::CallError::CALL_OK && VisualScriptCompiledPlan::is_foldable_value(r)) {
+				ConstantNode *constant = alloc_node<ConstantNode>();
+				constant->value = r;
+				return constant;
+			}
+		} break;
+		case ENode::TYPE_CALL: {
+			CallNode *call = static_cast<CallNode *>(p_node);
+			call->base = _fold_constants(call->base);
+			bool all_constant = call->base->type == ENode::TYPE_CONSTANT;
+			for (int i = 0; i < call->arguments.size(); i++) {
+				call->arguments.write[i] = _fold_constants(call->arguments[i]);
+				all_constant = all_constant && call->arguments[i]->type == ENode::TYPE_CONSTANT;
+			}
+
+			if (!all_constant) {
+				break;
+			}
+
+			// Only const methods of builtin types, anything else may have effects.
+			Variant base = static_cast<ConstantNode *>(call->base)->value;
+			if (!VisualScriptCompiledPlan::is_foldable_value(base) ||
+					!Variant::has_builtin_method(base.get_type(), call->method) ||
+					!Variant::is_builtin_method_const(base.get_type(), call->method)) {
+				break;
+			}
+
+			Vector<const Variant *> argp;
+			argp.resize(call->arguments.size());
+			for (int i = 0; i < call->arguments.size(); i++) {
+				argp.write[i] = &static_cast<ConstantNode *>(call->arguments[i])->value;
+			}
+
+			Variant r;
+			Callable::CallError ce;
+			base.callp(call->method, argp.ptrw(), argp.size(), r, ce);
+			if (ce.error == Callable::CallError::CALL_OK && VisualScriptCompiledPlan::is_foldable_value(r)) {
+				ConstantNode *constant = alloc_node<ConstantNode>();
+				constant->value = r;
+				return constant;
+			}
+		} break;
+		default: {
+		}
+	}
+
+	return p_node;
+}
+
+bool VisualScriptExpression::_is_program_current() const {
+	if (program.is_null() || program->expression != expression ||
+			program->output_type != output_type ||
+			program->input_types.size() != inputs.size()) {
+		return false;
+	}
+
+	for (int i = 0; i < inputs.size(); i++) {
+		if (program->input_types[i] != inputs[i].type ||
+				program->input_names[i] != inputs[i].name) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool VisualScriptExpression::_compile_expression() {
+	if (!expression_dirty) {
+		return program->error_set;
+	}
+
+	expression_dirty = false;
+
+	// Edits that end up where they started keep the program.
+	if (_is_program_current()) {
+		return program->error_set;
+	}
+
+	// Never modify the current program, running instances may be using it.
+	Ref<Program> compiled;
+	compiled.instantiate();
+	compiled->expression = expression;
+	compiled->output_type = output_type;
+	compiled->input_types.resize(inputs.size());
+	compiled->input_names.resize(inputs.size());
+	for (int i = 0; i < inputs.size(); i++) {
+		compiled->input_types.write[i] = inputs[i].type;
+		compiled->input_names.write[i] = inputs[i].name;
+	}
+
+	error_str = String();
+	error_set = false;
+	str_ofs = 0;
+
+	root = _parse_expression();
+
+	if (!error_set) {
+		root = _fold_constants(root);
+		compiled->result = _emit_node(root, compiled.ptr());
+	}
+
+	compiled->error_str = error_str;
+	compiled->error_set = error_set;
+
+	// The tree is only needed to emit the program.
+	_clear_nodes();
+
+	program = compiled;
+	return error_set;
+}
+
+class VisualScriptNodeInstanceExpression : public VisualScriptNodeInstance {
+public:
+	VisualScriptInstance *instance = nullptr;
+	Ref<VisualScriptExpressionProgram> program;
+
+	// One register per instruction, kept in working memory.
+	virtual int get_working_memory_size() const override {
+		return program->instructions.size();
+	}
+
+	static _FORCE_INLINE_ const Variant *_get_operand(int p_address,
+			const Variant **p_inputs, const Variant *p_constants,
+			const Variant *p_registers) {
+		int index = p_address & VisualScriptExpressionProgram::ADDRESS_MASK;
+		switch (p_address >> VisualScriptExpressionProgram::ADDRESS_BITS) {
+			case VisualScriptExpressionProgram::ADDRESS_TYPE_INPUT:
+				return p_inputs[index];
+			case VisualScriptExpressionProgram::ADDRESS_TYPE_CONSTANT:
+				return &p_constants[index];
+			default:
+				return &p_registers[index];
+		}
+	}
+
+	// Runs the instructions in order, each one writing its own register.
+	bool _execute(const Variant **p_inputs, Variant *p_registers,
+			String &r_error_str, Callable::CallError &ce) {
+		const VisualScriptExpressionProgram::Instruction *instructions =
+				program->instructions.ptr();
+		const int *operands = program->operands.ptr();
+		const Variant *constants = program->constants.ptr();
+		const Variant **argp =
+				(const Variant **)alloca(sizeof(Variant *) * MAX(1, program->max_arguments));
+
+#define OPERAND(m_idx) \
+	_get_operand(operands[ins.operand_ofs + (m_idx)], p_inputs, constants, p_registers)
+
+		for (int i = 0; i < program->instructions.size(); i++) {
+			const VisualScriptExpressionProgram::Instruction &ins = instructions[i];
+			Variant &r_ret = p_registers[i];
+
+			switch (ins.opcode) {
+				case VisualScriptExpressionProgram::Instruction::OPCODE_SELF: {
+					r_ret = instance->get_owner_ptr();
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_OPERATOR: {
+					static const Variant nil;
+					const Variant &a = *OPERAND(0);
+					const Variant &b = ins.operand_count > 1 ? *OPERAND(1) : nil;
+
+					bool valid = true;
+					Variant::evaluate(ins.op, a, b, r_ret, valid);
+					if (!valid) {
+						r_error_str = "Invalid operands to operator " +
+								Variant::get_operator_name(ins.op) + ": " +
+								Variant::get_type_name(a.get_type()) + " and " +
+								Variant::get_type_name(b.get_type()) + ".";
 						return true;
 					}
-
-					Variant value;
-					ret =
-							_execute(p_inputs, dictionary->dict[i + 1], value, r_error_str, ce);
-					if (ret) {
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_INDEX: {
+					const Variant &expression_base = *OPERAND(0);
+					const Variant &idx = *OPERAND(1);
+
+					bool valid;
+					r_ret = expression_base.get(idx, &valid);
+					if (!valid) {
+						r_error_str = "Invalid index of type " +
+								Variant::get_type_name(idx.get_type()) +
+								" for base of type " +
+								Variant::get_type_name(expression_base.get_type()) + ".";
 						return true;
 					}
-
-					d[key] = value;
-				}
-
-				r_ret = d;
-			} break;
-			case VisualScriptExpression::ENode::TYPE_CONSTRUCTOR: {
-				const VisualScriptExpression::ConstructorNode *constructor =
-						static_cast<const VisualScriptExpression::ConstructorNode *>(p_node);
-
-				Vector<Variant> arr;
-				Vector<const Variant *> argp;
-				arr.resize(constructor->arguments.size());
-				argp.resize(constructor->arguments.size());
-
-				for (int i = 0; i < constructor->arguments.size(); i++) {
-					Variant value;
-					bool ret = _execute(p_inputs, constructor->arguments[i], value,
-							r_error_str, ce);
-					if (ret) {
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_NAMED_INDEX: {
+					const Variant &typed_named_expression_base = *OPERAND(0);
+
+					bool valid;
+					r_ret = typed_named_expression_base.get_named(ins.name, valid);
+					if (!valid) {
+						r_error_str = "Invalid index '" + String(ins.name) +
+								"' for base of type " +
+								Variant::get_type_name(typed_named_expression_base.get_type()) + ".";
 						return true;
 					}
-					arr.write[i] = value;
-					argp.write[i] = &arr[i];
-				}
-
-				Variant::construct(constructor->data_type, r_ret,
-						(const Variant **)argp.ptr(), argp.size(), ce);
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_ARRAY: {
+					Array arr;
+					arr.resize(ins.operand_count);
+					for (int j = 0; j < ins.operand_count; j++) {
+						arr[j] = *OPERAND(j);
+					}
 
-				if (ce.error != Callable::CallError::CALL_OK) {
-					r_error_str = "Invalid arguments to construct '" +
-							Variant::get_type_name(constructor->data_type) + "'.";
-					return true;
-				}
+					r_ret = arr;
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_DICTIONARY: {
+					Dictionary d;
+					for (int j = 0; j < ins.operand_count; j += 2) {
+						d[*OPERAND(j + 0)] = *OPERAND(j + 1);
+					}
 
-			} break;
-			case VisualScriptExpression::ENode::TYPE_CALL: {
-				const VisualScriptExpression::CallNode *call =
-						static_cast<const VisualScriptExpression::CallNode *>(p_node);
-
-				Variant call_expression_base;
-				bool ret = _execute(p_inputs, call->base, call_expression_base, r_error_str, ce);
-				if (ret) {
-					return true;
-				}
+					r_ret = d;
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_CONSTRUCT: {
+					for (int j = 0; j < ins.operand_count; j++) {
+						argp[j] = OPERAND(j);
+					}
 
-				Vector<Variant> arr;
-				Vector<const Variant *> argp;
-				arr.resize(call->arguments.size());
-				argp.resize(call->arguments.size());
+					Variant::construct(ins.data_type, r_ret, argp, ins.operand_count, ce);
 
-				for (int i = 0; i < call->arguments.size(); i++) {
-					Variant value;
-					bool ret2 =
-							_execute(p_inputs, call->arguments[i], value, r_error_str, ce);
-					if (ret2) {
+					if (ce.error != Callable::CallError::CALL_OK) {
+						r_error_str = "Invalid arguments to construct '" +
+								Variant::get_type_name(ins.data_type) + "'.";
 						return true;
 					}
-					arr.write[i] = value;
-					argp.write[i] = &arr[i];
-				}
+				} break;
+				case VisualScriptExpressionProgram::Instruction::OPCODE_CALL: {
+					// The base is copied, calls may modify it.
+					Variant call_expression_base = *OPERAND(0);
 
-				call_expression_base.callp(call->method, (const Variant **)argp.ptr(), argp.size(), r_ret,
-						ce);
+					int argc = ins.operand_count - 1;
+					for (int j = 0; j < argc; j++) {
+						argp[j] = OPERAND(j + 1);
+					}
 
-				if (ce.error != Callable::CallError::CALL_OK) {
-					r_error_str = "On call to '" + String(call->method) + "':";
-					return true;
-				}
+					call_expression_base.callp(ins.name, argp, argc, r_ret, ce);
 
-			} break;
+					if (ce.error != Callable::CallError::CALL_OK) {
+						r_error_str = "On call to '" + String(ins.name) + "':";
+						return true;
+					}
+				} break;
+			}
 		}
+
+#undef OPERAND
+
 		return false;
 	}
 
 	virtual int step(const Variant **p_inputs, Variant **p_outputs,
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
-		if (!expression->root || expression->error_set) {
-			r_error_str = expression->error_str;
+		if (program->error_set) {
+			r_error_str = program->error_str;
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 			return 0;
 		}
 
-		bool error = _execute(p_inputs, expression->root, *p_outputs[0],
-				r_error_str, r_error);
+		bool error = _execute(p_inputs, p_working_mem, r_error_str, r_error);
 		if (error && r_error.error == Callable::CallError::CALL_OK) {
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 		}
 
+		if (!error) {
+			*p_outputs[0] = *_get_operand(program->result, p_inputs,
+					program->constants.ptr(), p_working_mem);
+		}
+
 #ifdef DEBUG_ENABLED
-		if (!error && expression->output_type != Variant::NIL &&
+		if (!error && program->output_type != Variant::NIL &&
 				!Variant::can_convert_strict(p_outputs[0]->get_type(),
-						expression->output_type)) {
+						program->output_type)) {
 			r_error_str += "Can't convert expression result from " +
 					Variant::get_type_name(p_outputs[0]->get_type()) + " to " +
-					Variant::get_type_name(expression->output_type) + ".";
+					Variant::get_type_name(program->output_type) + ".";
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 		}
 #endif
@@ -1510,16 +1751,15 @@ VisualScriptExpression::instantiate(VisualScriptInstance *p_instance) {
 	VisualScriptNodeInstanceExpression *instance =
 			memnew(VisualScriptNodeInstanceExpression);
 	instance->instance = p_instance;
-	instance->expression = this;
+	instance->program = program;
 	return instance;
 }
 
 void VisualScriptExpression::reset_state() {
-	if (nodes) {
-		memdelete(nodes);
-		nodes = nullptr;
-		root = nullptr;
-	}
+	_clear_nodes();
+
+	program.unref();
+	expression_dirty = true;
 
 	error_str = String();
 	error_set = false;
@@ -1530,9 +1770,7 @@ void VisualScriptExpression::reset_state() {
 VisualScriptExpression::VisualScriptExpression() {}
 
 VisualScriptExpression::~VisualScriptExpression() {
-	if (nodes) {
-		memdelete(nodes);
-	}
+	_clear_nodes();
 }
 
 void register_visual_script_expression_node() {
@@ -33,6 +33,70 @@
 
 #include "visual_script.h"
 
+// Compiled form of an expression: the parsed tree lowered into a flat list of
+// instructions, run in order by the node instance. Every instruction writes
+// one register (a slot of the node working memory); operands address a
+// register, an input port or a constant of the program.
+// It is never modified once built, so all instances of a script share it.
+class VisualScriptExpressionProgram : public RefCounted {
+	GDCLASS(VisualScriptExpressionProgram, RefCounted);
+
+	friend class VisualScriptExpression;
+	friend class VisualScriptNodeInstanceExpression;
+
+public:
+	enum {
+		ADDRESS_BITS = 24,
+		ADDRESS_MASK = (1 << ADDRESS_BITS) - 1,
+	};
+
+	enum AddressType {
+		ADDRESS_TYPE_REGISTER,
+		ADDRESS_TYPE_INPUT,
+		ADDRESS_TYPE_CONSTANT,
+	};
+
+	struct Instruction {
+		enum Opcode {
+			OPCODE_SELF,
+			OPCODE_OPERATOR,
+			OPCODE_INDEX,
+			OPCODE_NAMED_INDEX,
+			OPCODE_ARRAY,
+			OPCODE_DICTIONARY,
+			OPCODE_CONSTRUCT,
+			OPCODE_CALL,
+		};
+
+		Opcode opcode = OPCODE_SELF;
+		int operand_ofs = 0;
+		int operand_count = 0;
+		Variant::Operator op = Variant::OP_MAX;
+		Variant::Type data_type = Variant::NIL;
+		StringName name;
+	};
+
+	static _FORCE_INLINE_ int make_address(AddressType p_type, int p_index) {
+		return (p_type << ADDRESS_BITS) | p_index;
+	}
+
+private:
+	// What the program was compiled from.
+	String expression;
+	Vector<Variant::Type> input_types;
+	Vector<String> input_names;
+	Variant::Type output_type = Variant::NIL;
+
+	Vector<Instruction> instructions; // Instruction i writes register i.
+	Vector<int> operands;
+	Vector<Variant> constants;
+	int result = 0; // Address of the expression value.
+	int max_arguments = 0;
+
+	String error_str;
+	bool error_set = false;
+};
+
 class VisualScriptExpression : public VisualScriptNode {
 	GDCLASS(VisualScriptExpression, VisualScriptNode);
 	friend class VisualScriptNodeInstanceExpression;
@@ -131,11 +195,7 @@ class VisualScriptExpression : public VisualScriptNode {
 
 		Type type = Type::TYPE_SELF;
 
-		virtual ~ENode() {
-			if (next) {
-				memdelete(next);
-			}
-		}
+		virtual ~ENode() {}
 	};
 
 	struct Expression {
@@ -209,17 +269,30 @@ class VisualScriptExpression : public VisualScriptNode {
 		DictionaryNode() { type = TYPE_DICTIONARY; }
 	};
 
+	// Nodes are only alive while compiling, they are taken from the arena and
+	// chained through next so they can be destroyed together.
 	template <class T>
 	T *alloc_node() {
-		T *node = memnew(T);
+		T *node = memnew_placement(node_arena.alloc(sizeof(T)), T);
 		node->next = nodes;
 		nodes = node;
 		return node;
 	}
 
+	VisualScriptNodeArena node_arena;
 	ENode *root = nullptr;
 	ENode *nodes = nullptr;
 
+	void _clear_nodes();
+	ENode *_fold_constants(ENode *p_node);
+
+	typedef VisualScriptExpressionProgram Program;
+
+	Ref<Program> program;
+
+	bool _is_program_current() const;
+	int _emit_node(ENode *p_node, Program *p_program);
+
 protected:
 	bool _set(const StringName &p_name, const Variant &p_value);
 	bool _get(const StringName &p_name, Variant &r_ret) const;
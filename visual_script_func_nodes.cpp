@@ -35,6 +35,7 @@
 #include "core/os/os.h"
 #include "core/templates/local_vector.h"
 #include "core/variant/variant.h"
+#include "core/variant/variant_internal.h"
 #include "scene/main/node.h"
 #include "scene/main/scene_tree.h"
 #include "visual_script_nodes.h"
@@ -738,6 +739,7 @@ class VisualScriptNodeInstanceFunctionCall : public VisualScriptNodeInstance {
 public:
 	VisualScriptFunctionCall::CallMode call_mode;
 	NodePath node_path;
+	VisualScriptNodePathCache node_path_cache;
 	int input_args = 0;
 	bool validate = false;
 	int returns = 0;
@@ -748,11 +750,121 @@ public:
 	VisualScriptFunctionCall *node = nullptr;
 	VisualScriptInstance *instance = nullptr;
 
+	// Method of the last class called, scripted objects always go through
+	// callp() since the script may override it.
+	StringName bind_class;
+	MethodBind *method_bind = nullptr;
+	bool method_bind_validated = false;
+
+	Variant::Type basic_type = Variant::NIL;
+	Variant::ValidatedBuiltInMethod builtin_method = nullptr;
+
+	// Argument types the validated call expects, NIL takes any Variant.
+	LocalVector<Variant::Type> argument_types;
+	Variant::Type return_type = Variant::NIL;
+
 	// virtual int get_working_memory_size() const override { return 0; }
 	// virtual bool is_output_port_unsequenced(int p_idx) const { return false; }
 	// virtual bool get_output_port_unsequenced(int p_idx,Variant*
 	// r_value,Variant* p_working_mem,String &r_error) const { return true; }
 
+	void resolve_builtin_method() {
+		if (!Variant::has_builtin_method(basic_type, function) ||
+				Variant::is_builtin_method_vararg(basic_type, function) ||
+				Variant::get_builtin_method_argument_count(basic_type, function) !=
+						input_args) {
+			return;
+		}
+
+		argument_types.resize(input_args);
+		for (int i = 0; i < input_args; i++) {
+			argument_types[i] =
+					Variant::get_builtin_method_argument_type(basic_type, function, i);
+			if (argument_types[i] == Variant::OBJECT) {
+				return; // Validated calls don't check the class.
+			}
+		}
+
+		return_type = Variant::has_builtin_method_return_value(basic_type, function)
+				? Variant::get_builtin_method_return_type(basic_type, function)
+				: Variant::NIL;
+		builtin_method = Variant::get_validated_builtin_method(basic_type, function);
+	}
+
+	void resolve_method_bind(Object *p_object) {
+		bind_class = p_object->get_class_name();
+		method_bind = ClassDB::get_method(bind_class, function);
+		method_bind_validated = false;
+
+		if (!method_bind || method_bind->is_vararg() ||
+				method_bind->get_argument_count() != input_args) {
+			return;
+		}
+
+		argument_types.resize(input_args);
+		for (int i = 0; i < input_args; i++) {
+			argument_types[i] = method_bind->get_argument_type(i);
+			if (argument_types[i] == Variant::OBJECT) {
+				return; // Validated calls don't check the class.
+			}
+		}
+
+		return_type = method_bind->has_return()
+				? method_bind->get_return_info().type
+				: Variant::NIL;
+		method_bind_validated = true;
+	}
+
+	_FORCE_INLINE_ bool can_validate(const Variant **p_args) const {
+		for (int i = 0; i < input_args; i++) {
+			if (argument_types[i] != Variant::NIL &&
+					p_args[i]->get_type() != argument_types[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	_FORCE_INLINE_ void call_object(Object *p_object, const Variant **p_args,
+			Variant *r_ret, Callable::CallError &r_error) {
+		if (!p_object->get_script_instance()) {
+			if (p_object->get_class_name() != bind_class) {
+				resolve_method_bind(p_object);
+			}
+
+			if (method_bind) {
+				if (method_bind_validated && can_validate(p_args)) {
+					VariantInternal::initialize(r_ret, return_type);
+					method_bind->validated_call(p_object, p_args, r_ret);
+					return;
+				}
+
+				*r_ret = method_bind->call(p_object, p_args, input_args, r_error);
+				return;
+			}
+		}
+
+		*r_ret = p_object->callp(function, p_args, input_args, r_error);
+	}
+
+	_FORCE_INLINE_ void call_variant(Variant &p_base, const Variant **p_args,
+			Variant *r_ret, Callable::CallError &r_error) {
+		if (call_mode == VisualScriptFunctionCall::CALL_MODE_INSTANCE) {
+			Object *object = p_base.get_validated_object();
+			if (object) {
+				call_object(object, p_args, r_ret, r_error);
+				return;
+			}
+		} else if (builtin_method && p_base.get_type() == basic_type &&
+				can_validate(p_args)) {
+			VariantInternal::initialize(r_ret, return_type);
+			builtin_method(&p_base, p_args, input_args, r_ret);
+			return;
+		}
+
+		p_base.callp(function, p_args, input_args, *r_ret, r_error);
+	}
+
 	_FORCE_INLINE_ bool call_rpc(Object *p_base, const Variant **p_args,
 			int p_argcount) {
 		if (!p_base) {
@@ -795,9 +907,10 @@ public:
 				if (rpc_mode) {
 					call_rpc(object, p_inputs, input_args);
 				} else if (returns) {
-					*p_outputs[0] = object->callp(function, p_inputs, input_args, r_error);
+					call_object(object, p_inputs, p_outputs[0], r_error);
 				} else {
-					object->callp(function, p_inputs, input_args, r_error);
+					Variant ret;
+					call_object(object, p_inputs, &ret, r_error);
 				}
 			} break;
 			case VisualScriptFunctionCall::CALL_MODE_NODE_PATH: {
@@ -808,7 +921,7 @@ public:
 					return 0;
 				}
 
-				Node *another = call_node->get_node(node_path);
+				Node *another = node_path_cache.get_node(call_node, node_path);
 				if (!another) {
 					r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 					r_error_str = "Path does not lead Node!";
@@ -818,9 +931,10 @@ public:
 				if (rpc_mode) {
 					call_rpc(call_node, p_inputs, input_args);
 				} else if (returns) {
-					*p_outputs[0] = another->callp(function, p_inputs, input_args, r_error);
+					call_object(another, p_inputs, p_outputs[0], r_error);
 				} else {
-					another->callp(function, p_inputs, input_args, r_error);
+					Variant ret;
+					call_object(another, p_inputs, &ret, r_error);
 				}
 
 			} break;
@@ -836,10 +950,10 @@ public:
 				} else if (returns) {
 					if (call_mode == VisualScriptFunctionCall::CALL_MODE_INSTANCE) {
 						if (returns >= 2) {
-							v.callp(function, p_inputs + 1, input_args, *p_outputs[1], r_error);
+							call_variant(v, p_inputs + 1, p_outputs[1], r_error);
 						} else if (returns == 1) {
 							Variant ret;
-							v.callp(function, p_inputs + 1, input_args, ret, r_error);
+							call_variant(v, p_inputs + 1, &ret, r_error);
 						} else {
 							r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 							r_error_str =
@@ -847,11 +961,11 @@ public:
 							return 0;
 						}
 					} else {
-						v.callp(function, p_inputs + 1, input_args, *p_outputs[0], r_error);
+						call_variant(v, p_inputs + 1, p_outputs[0], r_error);
 					}
 				} else {
 					Variant ret;
-					v.callp(function, p_inputs + 1, input_args, ret, r_error);
+					call_variant(v, p_inputs + 1, &ret, r_error);
 				}
 
 				if (call_mode == VisualScriptFunctionCall::CALL_MODE_INSTANCE) {
@@ -870,9 +984,10 @@ public:
 				if (rpc_mode) {
 					call_rpc(object, p_inputs, input_args);
 				} else if (returns) {
-					*p_outputs[0] = object->callp(function, p_inputs, input_args, r_error);
+					call_object(object, p_inputs, p_outputs[0], r_error);
 				} else {
-					object->callp(function, p_inputs, input_args, r_error);
+					Variant ret;
+					call_object(object, p_inputs, &ret, r_error);
 				}
 			} break;
 		}
@@ -905,6 +1020,10 @@ VisualScriptFunctionCall::instantiate(VisualScriptInstance *p_instance) {
 							: 0);
 	instance->rpc_mode = rpc_call_mode;
 	instance->validate = validate;
+	if (call_mode == CALL_MODE_BASIC_TYPE) {
+		instance->basic_type = basic_type;
+		instance->resolve_builtin_method();
+	}
 	return instance;
 }
 
@@ -1495,6 +1614,7 @@ class VisualScriptNodeInstancePropertySet : public VisualScriptNodeInstance {
 public:
 	VisualScriptPropertySet::CallMode call_mode;
 	NodePath node_path;
+	VisualScriptNodePathCache node_path_cache;
 	StringName property;
 
 	VisualScriptPropertySet *node = nullptr;
@@ -1599,7 +1719,8 @@ public:
 					return 0;
 				}
 
-				Node *another = instance_call_mode_node->get_node(node_path);
+				Node *another =
+						node_path_cache.get_node(instance_call_mode_node, node_path);
 				if (!another) {
 					r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 					r_error_str = "Path does not lead Node!";
@@ -2226,6 +2347,7 @@ class VisualScriptNodeInstancePropertyGet : public VisualScriptNodeInstance {
 public:
 	VisualScriptPropertyGet::CallMode call_mode;
 	NodePath node_path;
+	VisualScriptNodePathCache node_path_cache;
 	StringName property;
 	StringName index;
 
@@ -2261,7 +2383,8 @@ public:
 					return 0;
 				}
 
-				Node *another = step_instance_call_mode_node->get_node(node_path);
+				Node *another = node_path_cache.get_node(step_instance_call_mode_node,
+						node_path);
 				if (!another) {
 					r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 					r_error_str = RTR("Path does not lead Node!");
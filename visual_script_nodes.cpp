@@ -35,6 +35,7 @@
 #include "core/core_constants.h"
 #include "core/input/input.h"
 #include "core/os/os.h"
+#include "core/variant/variant_internal.h"
 #include "scene/main/node.h"
 #include "scene/main/scene_tree.h"
 
@@ -334,6 +335,9 @@ VisualScriptFunction::VisualScriptFunction() {
 
 void VisualScriptFunction::set_stack_less(bool p_enable) {
 	stack_less = p_enable;
+	if (get_visual_script().is_valid()) {
+		get_visual_script()->invalidate_compiled_plan();
+	}
 	notify_property_list_changed();
 }
 
@@ -348,6 +352,9 @@ bool VisualScriptFunction::is_sequenced() const { return sequenced; }
 void VisualScriptFunction::set_stack_size(int p_size) {
 	ERR_FAIL_COND(p_size < 1 || p_size > 100000);
 	stack_size = p_size;
+	if (get_visual_script().is_valid()) {
+		get_visual_script()->invalidate_compiled_plan();
+	}
 }
 
 int VisualScriptFunction::get_stack_size() const { return stack_size; }
@@ -1125,11 +1132,28 @@ public:
 	bool unary = false;
 	Variant::Operator op;
 
+	// Set when the operand types are known, used while the inputs match them.
+	Variant::ValidatedOperatorEvaluator evaluator = nullptr;
+	Variant::Type type_a = Variant::NIL;
+	Variant::Type type_b = Variant::NIL;
+	Variant::Type return_type = Variant::NIL;
+
 	// virtual int get_working_memory_size() const override { return 0; }
 
 	virtual int step(const Variant **p_inputs, Variant **p_outputs,
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
+		if (evaluator && p_inputs[0]->get_type() == type_a &&
+				(unary || p_inputs[1]->get_type() == type_b)) {
+			static const Variant nil;
+			// Validated evaluators write in place, the result must have its type.
+			if (p_outputs[0]->get_type() != return_type) {
+				VariantInternal::initialize(p_outputs[0], return_type);
+			}
+			evaluator(p_inputs[0], unary ? &nil : p_inputs[1], p_outputs[0]);
+			return 0;
+		}
+
 		bool valid;
 		if (unary) {
 			Variant::evaluate(op, *p_inputs[0], Variant(), *p_outputs[0], valid);
@@ -1166,6 +1190,21 @@ VisualScriptOperator::instantiate(VisualScriptInstance *p_instance) {
 			memnew(VisualScriptNodeInstanceOperator);
 	instance->unary = get_input_value_port_count() == 1;
 	instance->op = op;
+
+	// Division and modulo are left to the generic path, which reports division
+	// by zero instead of returning zero. So are bit shifts, which it checks
+	// for negative operands instead of shifting by a negative count.
+	if (op != Variant::OP_DIVIDE && op != Variant::OP_MODULE &&
+			op != Variant::OP_SHIFT_LEFT && op != Variant::OP_SHIFT_RIGHT) {
+		Variant::Type a = get_input_value_port_info(0).type;
+		Variant::Type b = instance->unary ? Variant::NIL : get_input_value_port_info(1).type;
+		if (a != Variant::NIL && (instance->unary || b != Variant::NIL)) {
+			instance->evaluator = Variant::get_validated_operator_evaluator(op, a, b);
+			instance->type_a = a;
+			instance->type_b = b;
+			instance->return_type = Variant::get_operator_return_type(op, a, b);
+		}
+	}
 	return instance;
 }
 
@@ -1356,16 +1395,19 @@ public:
 	VisualScriptVariableGet *node = nullptr;
 	VisualScriptInstance *instance = nullptr;
 	StringName variable;
+	int slot = -1;
 
 	virtual int step(const Variant **p_inputs, Variant **p_outputs,
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
-		if (!instance->get_variable(variable, p_outputs[0])) {
+		if (slot < 0) {
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 			r_error_str = RTR("VariableGet not found in script:") + " '" +
 					String(variable) + "'";
 			return 0;
 		}
+
+		*p_outputs[0] = instance->get_variable_by_slot(slot);
 		return 0;
 	}
 };
@@ -1377,6 +1419,9 @@ VisualScriptVariableGet::instantiate(VisualScriptInstance *p_instance) {
 	instance->node = this;
 	instance->instance = p_instance;
 	instance->variable = variable;
+	if (p_instance) {
+		instance->slot = p_instance->get_variable_slot(variable);
+	}
 	return instance;
 }
 
@@ -1470,18 +1515,21 @@ public:
 	VisualScriptVariableSet *node = nullptr;
 	VisualScriptInstance *instance = nullptr;
 	StringName variable;
+	int slot = -1;
 
 	// virtual int get_working_memory_size() const override { return 0; }
 
 	virtual int step(const Variant **p_inputs, Variant **p_outputs,
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
-		if (!instance->set_variable(variable, *p_inputs[0])) {
+		if (slot < 0) {
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 			r_error_str = RTR("VariableSet not found in script:") + " '" +
 					String(variable) + "'";
+			return 0;
 		}
 
+		instance->get_variable_by_slot(slot) = *p_inputs[0];
 		return 0;
 	}
 };
@@ -1493,6 +1541,9 @@ VisualScriptVariableSet::instantiate(VisualScriptInstance *p_instance) {
 	instance->node = this;
 	instance->instance = p_instance;
 	instance->variable = variable;
+	if (p_instance) {
+		instance->slot = p_instance->get_variable_slot(variable);
+	}
 	return instance;
 }
 
@@ -2471,6 +2522,7 @@ public:
 	VisualScriptSceneNode *node = nullptr;
 	VisualScriptInstance *instance = nullptr;
 	NodePath path;
+	VisualScriptNodePathCache path_cache;
 
 	// virtual int get_working_memory_size() const override { return 0; }
 
@@ -2484,7 +2536,7 @@ public:
 			return 0;
 		}
 
-		Node *another = step_node_node->get_node(path);
+		Node *another = path_cache.get_node(step_node_node, path);
 		if (!another) {
 			r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 			r_error_str = "Path does not lead Node!";
@@ -3019,6 +3071,8 @@ public:
 	int work_mem_size = 0;
 
 	virtual int get_working_memory_size() const override { return work_mem_size; }
+	// Scripts decide at runtime, and yielding needs working memory.
+	virtual bool can_yield() const override { return work_mem_size > 0; }
 	virtual int step(const Variant **p_inputs, Variant **p_outputs,
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
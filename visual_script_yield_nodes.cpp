@@ -90,6 +90,9 @@ public:
 	virtual int get_working_memory_size() const override {
 		return 1;
 	} // yield needs at least 1
+	virtual bool can_yield() const override {
+		return mode != VisualScriptYield::YIELD_RETURN;
+	}
 	// virtual bool is_output_port_unsequenced(int p_idx) const { return false; }
 	// virtual bool get_output_port_unsequenced(int p_idx,Variant*
 	// r_value,Variant* p_working_mem,String &r_error) const { return false; }
@@ -102,16 +105,16 @@ public:
 		} else {
 			// yield
 
-			SceneTree *tree =
-					Object::cast_to<SceneTree>(OS::get_singleton()->get_main_loop());
+			// The running tree, also there in tests, which have no main loop.
+			SceneTree *tree = SceneTree::get_singleton();
 			if (!tree) {
 				r_error_str = "Main Loop is not SceneTree";
 				r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 				return 0;
 			}
 
-			Ref<VisualScriptFunctionState> state;
-			state.instantiate();
+			Ref<VisualScriptFunctionState> state =
+					VisualScriptLanguage::singleton->create_function_state();
 
 			int ret = STEP_YIELD_BIT;
 			switch (mode) {
@@ -119,14 +122,13 @@ public:
 					ret = STEP_EXIT_FUNCTION_BIT;
 					break; // return the yield
 				case VisualScriptYield::YIELD_FRAME:
-					state->connect_to_signal(tree, "process_frame", Array());
+					VisualScriptLanguage::singleton->queue_frame_resume(tree, false, state);
 					break;
 				case VisualScriptYield::YIELD_PHYSICS_FRAME:
-					state->connect_to_signal(tree, "physics_frame", Array());
+					VisualScriptLanguage::singleton->queue_frame_resume(tree, true, state);
 					break;
 				case VisualScriptYield::YIELD_WAIT:
-					state->connect_to_signal(tree->create_timer(wait_time).ptr(), "timeout",
-							Array());
+					VisualScriptLanguage::singleton->queue_timer_resume(wait_time, state);
 					break;
 			}
 
@@ -523,13 +525,16 @@ class VisualScriptNodeInstanceYieldSignal : public VisualScriptNodeInstance {
 public:
 	VisualScriptYieldSignal::CallMode call_mode;
 	NodePath node_path;
+	VisualScriptNodePathCache node_path_cache;
 	int output_args = 0;
 	StringName signal;
 
 	VisualScriptYieldSignal *node = nullptr;
 	VisualScriptInstance *instance = nullptr;
 
-	virtual int get_working_memory_size() const override { return 1; }
+	// The state, then the signal arguments.
+	virtual int get_working_memory_size() const override { return 1 + output_args; }
+	virtual bool can_yield() const override { return true; }
 	// virtual bool is_output_port_unsequenced(int p_idx) const { return false; }
 	// virtual bool get_output_port_unsequenced(int p_idx,Variant*
 	// r_value,Variant* p_working_mem,String &r_error) const { return true; }
@@ -538,7 +543,11 @@ public:
 			StartMode p_start_mode, Variant *p_working_mem,
 			Callable::CallError &r_error, String &r_error_str) override {
 		if (p_start_mode == START_MODE_RESUME_YIELD) {
-			return 0; // resuming yield
+			// Resuming yield, the signal left its arguments after the state.
+			for (int i = 0; i < output_args; i++) {
+				*p_outputs[i] = p_working_mem[i + 1];
+			}
+			return 0;
 		} else {
 			// yield
 
@@ -557,7 +566,7 @@ public:
 						return 0;
 					}
 
-					Node *another = yield_node->get_node(node_path);
+					Node *another = node_path_cache.get_node(yield_node, node_path);
 					if (!another) {
 						r_error.error = Callable::CallError::CALL_ERROR_INVALID_METHOD;
 						r_error_str = "Path does not lead Node!";
@@ -578,10 +587,10 @@ public:
 				} break;
 			}
 
-			Ref<VisualScriptFunctionState> state;
-			state.instantiate();
+			Ref<VisualScriptFunctionState> state =
+					VisualScriptLanguage::singleton->create_function_state();
 
-			state->connect_to_signal(object, signal, Array());
+			state->connect_signal_resume(object, signal, output_args);
 
 			*p_working_mem = state;
 